@@ -90,6 +90,7 @@ IniConfig::~IniConfig() { clear(); }
 void IniConfig::clear() {
 	// [Player] section
 	player_s.database.clear ();
+	player_s.loudnessDb.clear();
 	player_s.playLength   = 0;				 // infinite play time!
 	player_s.recordLength = (4 * 60) * 1000; // 4 minutes recording time
 #ifdef FEAT_NEW_PLAY_API
@@ -100,6 +101,7 @@ void IniConfig::clear() {
 	player_s.chargenRom.clear();
 	player_s.verboseLevel = 0;
 	player_s.quietLevel   = 0;
+	player_s.renderCache  = false;
 
 	// [Console] section, characters
 	console_s.ansi			= false;
@@ -137,6 +139,8 @@ void IniConfig::clear() {
 	audio_s.sampleRate = SidConfig::DEFAULT_SAMPLING_FREQ;
 	audio_s.channels   = 0;
 	audio_s.bitDepth   = 16;
+	audio_s.bufferTime = 0;
+	audio_s.periodTime = 0;
 
 	// [Emulation] section
 	emulation_s.modelDefault = SidConfig::PAL;
@@ -342,6 +346,8 @@ void IniConfig::readPlayer(iniHandler &ini) {
 			player_s.database.assign(buffer);
 	}
 
+	player_s.loudnessDb = readString(ini, TEXT("Loudness DB"));
+
 	int time;
 	if (readTime(ini, TEXT("Default Play Time"), time))
 		player_s.playLength = time;
@@ -360,6 +366,8 @@ void IniConfig::readPlayer(iniHandler &ini) {
 
 	readInt(ini, TEXT("Verboseness"), player_s.verboseLevel);
 	readInt(ini, TEXT("Quietness"), player_s.quietLevel);
+
+	readBool(ini, TEXT("Render Cache"), player_s.renderCache);
 }
 
 
@@ -404,6 +412,8 @@ void IniConfig::readAudio(iniHandler &ini) {
 	readInt(ini, TEXT("Sample Rate"), audio_s.sampleRate);
     readInt(ini, TEXT("Channels"),    audio_s.channels);
 	readInt(ini, TEXT("Bit Depth"),   audio_s.bitDepth);
+	readInt(ini, TEXT("Buffer Time"), audio_s.bufferTime);
+	readInt(ini, TEXT("Period Time"), audio_s.periodTime);
 }
 
 
@@ -38,6 +38,7 @@ class IniConfig {
 public:
 	struct player_section { // [Player] section
 		SID_STRING	   database;
+		SID_STRING	   loudnessDb;
 		uint_least32_t playLength;
 		uint_least32_t recordLength;
 #ifdef FEAT_NEW_PLAY_API
@@ -48,6 +49,7 @@ public:
 		SID_STRING	   chargenRom;
 		int			   verboseLevel;
 		int			   quietLevel;
+		bool		   renderCache;
 	};
 
 	struct console_section { // [Console] section
@@ -86,6 +88,8 @@ public:
 		int sampleRate; // in Hz
 		int channels;
 		int bitDepth;
+		int bufferTime; // in ms
+		int periodTime; // in ms
 	};
 
 	struct emulation_section { // [Emulation] section
@@ -0,0 +1,621 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2024-2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "analyzer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+#include <sidplayfp/sidplayfp.h>
+#include <sidplayfp/sidbuilder.h>
+#include <sidplayfp/SidTune.h>
+#include <sidplayfp/SidInfo.h>
+#include <sidplayfp/SidTuneInfo.h>
+#include <sidplayfp/SidDatabase.h>
+
+#include "sidlib_features.h"
+#include "sidcxx.h"
+
+#ifdef FEAT_NEW_PLAY_API
+# include "mixer.h"
+#endif
+
+using std::cerr;
+using std::endl;
+
+// A window quieter than this, peak to peak, is silence
+static constexpr int SILENCE_LEVEL = 64;
+
+// Windows of 20 ms
+static constexpr uint_least32_t WINDOWS_PER_SEC = 50;
+
+// A repeat has to hold for a whole loop and at least this
+// long (milliseconds) to count, so that a bar played twice
+// isn't taken for the loop of the tune
+static constexpr uint_least32_t LOOP_CONFIRM = 30000;
+
+// 64-bit FNV-1a parameters
+static constexpr uint_least64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+static constexpr uint_least64_t FNV_PRIME  = 0x100000001b3ULL;
+
+namespace {
+
+#ifdef FEAT_NEW_PLAY_API
+// Tracks when the SIDs last made a sound
+class SilenceDetector {
+private:
+	const uint_least32_t m_window;
+
+	uint_least64_t m_position;	// samples so far
+	uint_least64_t m_lastSound; // end of the last window with sound
+	uint_least32_t m_filled;
+	int			   m_lo[3];
+	int			   m_hi[3];
+
+public:
+	SilenceDetector(uint_least32_t rate) :
+		m_window(rate / WINDOWS_PER_SEC),
+		m_position(0),
+		m_lastSound(0),
+		m_filled(0) {}
+
+	void feed(short *buffers[], unsigned int chips, int samples) {
+		for (int i = 0; i < samples; i++) {
+			for (unsigned int c = 0; c < chips; c++) {
+				const int sample = buffers[c][i];
+
+				if (!m_filled) {
+					m_lo[c] = m_hi[c] = sample;
+				} else {
+					m_lo[c] = std::min(m_lo[c], sample);
+					m_hi[c] = std::max(m_hi[c], sample);
+				}
+			}
+
+			m_position++;
+			if (++m_filled < m_window)
+				continue;
+
+			m_filled = 0;
+			for (unsigned int c = 0; c < chips; c++) {
+				if (m_hi[c] - m_lo[c] > SILENCE_LEVEL)
+					m_lastSound = m_position;
+			}
+		}
+	}
+
+	uint_least64_t silent() const { return m_position - m_lastSound; }
+	uint_least64_t lastSound() const { return m_lastSound; }
+};
+
+// Finds the earliest stretch of frames that repeats. Frames
+// with the same state are merged into runs first, so that a
+// held note doesn't look like a loop of one frame.
+class LoopDetector {
+private:
+	struct run_t {
+		uint_least64_t hash;
+		uint_least64_t start;  // cycles
+		uint_least32_t frames;
+		uint_least32_t period; // cycles per frame
+
+		uint_least64_t key() const {
+			return (hash ^ frames) * FNV_PRIME;
+		}
+
+		uint_least64_t end() const {
+			return start + (uint_least64_t)frames * period;
+		}
+	};
+
+	const uint_least64_t m_confirm; // cycles
+
+	std::vector<run_t> m_runs; // the last one is still growing
+
+	// Where each run was seen before
+	std::unordered_map<uint_least64_t, std::vector<size_t>> m_seen;
+
+	// Possible loop lengths in runs, and the first run of
+	// the second pass through them
+	std::map<size_t, size_t> m_candidates;
+
+private:
+	bool close(size_t n, Analyzer::loop_t &loop) {
+		const uint_least64_t key = m_runs[n].key();
+
+		// Drop the candidates that stopped repeating
+		for (auto it = m_candidates.begin(); it != m_candidates.end();) {
+			if (m_runs[n - it->first].key() != key)
+				it = m_candidates.erase(it);
+			else
+				++it;
+		}
+
+		std::vector<size_t> &seen = m_seen[key];
+		for (const size_t j : seen)
+			m_candidates.emplace(n - j, n);
+		seen.push_back(n);
+
+		bool found = false;
+
+		for (const auto &candidate : m_candidates) {
+			const size_t period = candidate.first;
+			const size_t second = candidate.second;
+
+			uint_least64_t start  = m_runs[second - period].start;
+			uint_least64_t length = m_runs[second].start - start;
+
+			if (m_runs[n].end() - m_runs[second].start < std::max(length, m_confirm))
+				continue;
+
+			// Only the ends of the runs before both passes
+			// may match, which moves the start back a bit
+			if (second - period > 0) {
+				const run_t &a = m_runs[second - period - 1];
+				const run_t &b = m_runs[second - 1];
+
+				if ((a.hash == b.hash) && (a.period == b.period))
+					start -= (uint_least64_t)std::min(a.frames, b.frames) * a.period;
+			}
+
+			if (!found || (start < loop.start)
+					|| ((start == loop.start) && (length < loop.length))) {
+				loop.start	= start;
+				loop.length = length;
+				found		= true;
+			}
+		}
+
+		return found;
+	}
+
+public:
+	LoopDetector(uint_least64_t confirm) : m_confirm(confirm) {}
+
+	// Add the state after a frame, true once a loop is certain
+	bool feed(uint_least64_t hash, uint_least64_t start, uint_least32_t period,
+			  Analyzer::loop_t &loop) {
+		if (!m_runs.empty()) {
+			run_t &last = m_runs.back();
+
+			if ((last.hash == hash) && (last.period == period)) {
+				last.frames++;
+				return false;
+			}
+
+			if (close(m_runs.size() - 1, loop))
+				return true;
+		}
+
+		m_runs.push_back({ hash, start, 1, period });
+		return false;
+	}
+};
+#endif // FEAT_NEW_PLAY_API
+
+} // namespace
+
+Analyzer::Analyzer(const SidConfig &config, builder_factory_t factory) :
+	m_mode(SONGLENGTHS),
+	m_config(config),
+	m_factory(std::move(factory)),
+	m_filter(true),
+	m_maxLength(MAX_LENGTH),
+	m_silence(SILENCE) {
+	m_config.sidEmulation = nullptr;
+
+#ifndef FEAT_NEW_PLAY_API
+	// Only the mix comes out of the old API, and
+	// channels don't matter for finding the end
+	m_config.playback = SidConfig::MONO;
+#endif
+}
+
+bool Analyzer::add(const std::string &path, SidDatabase *known) {
+	SidTune sidTune(path.c_str());
+	if (!sidTune.getStatus())
+		return false;
+
+	char md5[SidTune::MD5_LENGTH + 1];
+	sidTune.createMD5New(md5);
+
+	const unsigned int songs = sidTune.getInfo()->songs();
+
+	if (known && (m_mode == SONGLENGTHS)) {
+		unsigned int song = 1;
+		while ((song <= songs) && (known->lengthMs(md5, song) > 0))
+			song++;
+
+		if (song > songs) // nothing left to find
+			return true;
+	}
+
+	tune_t tune = { path, md5, std::vector<uint_least32_t>(songs, 0), {} };
+
+	// Loudness is measured over the known lengths
+	if (known && (m_mode == LOUDNESS)) {
+		for (unsigned int song = 1; song <= songs; song++)
+			tune.lengths[song - 1] = std::max<int_least32_t>(known->lengthMs(md5, song), 0);
+	}
+
+	if (m_mode == LOUDNESS)
+		tune.loudness.resize(songs, { LoudnessMeter::SILENT, 0.0, LoudnessMeter::SILENT });
+
+	m_tunes.push_back(std::move(tune));
+
+	for (unsigned int song = 1; song <= songs; song++)
+		m_jobs.push_back({ m_tunes.size() - 1, song });
+
+	return true;
+}
+
+void Analyzer::run(void) {
+	size_t	   next = 0;
+	std::mutex lock;
+
+	const unsigned int threads = std::max(1U,
+		std::min<unsigned int>(std::thread::hardware_concurrency(), m_jobs.size()));
+
+	std::vector<std::thread> pool;
+	for (unsigned int i = 0; i < threads; i++)
+		pool.emplace_back(&Analyzer::worker, this, std::ref(next), std::ref(lock));
+
+	for (std::thread &thread : pool)
+		thread.join();
+}
+
+void Analyzer::worker(size_t &next, std::mutex &lock) {
+	sidplayfp engine;
+	engine.setRoms(rom(m_kernal), rom(m_basic), rom(m_chargen));
+
+	for (;;) {
+		size_t index;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (next == m_jobs.size())
+				break;
+			index = next++;
+		}
+
+		const job_t &job = m_jobs[index];
+		tune_t &tune	 = m_tunes[job.tune];
+
+		// The engine keeps a pointer to the tune
+		SidTune sidtune(tune.path.c_str());
+		sidtune.selectSong(job.song);
+
+		if (!setup(engine, sidtune, static_cast<bool>(m_factory))) {
+			std::lock_guard<std::mutex> guard(lock);
+			cerr << tune.path << " #" << job.song << ": "
+				 << (sidtune.getStatus() ? engine.error() : sidtune.statusString())
+				 << endl;
+			continue;
+		}
+
+#ifdef FEAT_NEW_PLAY_API
+		std::unique_ptr<LoudnessMeter> meter;
+		if (m_mode == LOUDNESS) {
+			meter.reset(new LoudnessMeter(m_config.frequency,
+				(m_config.playback == SidConfig::STEREO) ? 2 : 1));
+		}
+#else
+		std::unique_ptr<LoudnessMeter> meter;
+#endif
+
+		uint_least32_t length = tune.lengths[job.song - 1];
+		if (!findEnd(engine, sidtune, length, nullptr, meter.get())) {
+			std::lock_guard<std::mutex> guard(lock);
+			cerr << tune.path << " #" << job.song << ": " << engine.error() << endl;
+		} else if (!length) {
+			std::lock_guard<std::mutex> guard(lock);
+			cerr << tune.path << " #" << job.song << ": no end found in "
+				 << formatTime(m_maxLength) << endl;
+		}
+
+		// Each job has its own slot
+		tune.lengths[job.song - 1] = length;
+
+		if (meter) {
+			const uint_least64_t frames = (uint_least64_t)
+				(length ? length : m_maxLength) * m_config.frequency / 1000;
+			tune.loudness[job.song - 1] = meter->result(frames);
+		}
+
+		// Drop the emulation
+		sidbuilder *builder = engine.config().sidEmulation;
+		SidConfig config	= m_config;
+		engine.config(config);
+		delete builder;
+	}
+}
+
+bool Analyzer::findLoop(const std::string &path, unsigned int song, loop_t &loop) {
+	sidplayfp engine;
+	engine.setRoms(rom(m_kernal), rom(m_basic), rom(m_chargen));
+
+	SidTune tune(path.c_str());
+	tune.selectSong(song);
+
+	uint_least32_t length = 0;
+	return setup(engine, tune, false)
+		&& findEnd(engine, tune, length, &loop)
+		&& length && loop.length;
+}
+
+bool Analyzer::setup(sidplayfp &engine, SidTune &tune, bool synthesis) {
+	if (!tune.getStatus() || !engine.load(&tune))
+		return false;
+
+	SidConfig config = m_config;
+
+	if (synthesis) {
+		const bool is6581 = (
+			((m_config.defaultSidModel == SidConfig::MOS6581) &&
+			m_config.forceSidModel) ||
+#ifdef FEAT_NEW_SID_MODEL
+			 (engine.info().sidModel(0) == SidTuneInfo::SIDMODEL_6581)
+#else
+			 (tune.getInfo()->sidModel(0) == SidTuneInfo::SIDMODEL_6581)
+#endif
+		);
+
+		{
+			std::lock_guard<std::mutex> guard(m_factoryLock);
+			config.sidEmulation = m_factory(is6581);
+		}
+
+		if (!config.sidEmulation) // already reported
+			return false;
+	}
+
+	if (!engine.config(config)) {
+		delete config.sidEmulation;
+		return false;
+	}
+
+#ifdef FEAT_FILTER_DISABLE
+	if (synthesis) {
+		for (unsigned int i = 0; i < 3; i++)
+			engine.filter(i, m_filter);
+	}
+#endif
+
+	return true;
+}
+
+// Emulate a subtune until it goes silent, repeats itself or
+// reaches the longest length, in which case length is 0. If
+// the length is already known, emulate just that much. The
+// mix goes to the meter if there's one.
+bool Analyzer::findEnd(sidplayfp &engine, SidTune &tune, uint_least32_t &length,
+					   loop_t *loop, LoudnessMeter *meter) {
+	const SidTuneInfo *tuneInfo = tune.getInfo();
+
+	const uint_least32_t known = length;
+	length = 0;
+
+#ifdef FEAT_NEW_PLAY_API
+	// Frames last as long as the video ones, unless the
+	// tune sets its own speed with CIA #1
+	SidConfig::c64_model_t model = m_config.defaultC64Model;
+	if (!m_config.forceC64Model) {
+		if (tuneInfo->clockSpeed() == SidTuneInfo::CLOCK_PAL)
+			model = SidConfig::PAL;
+		else if (tuneInfo->clockSpeed() == SidTuneInfo::CLOCK_NTSC)
+			model = SidConfig::NTSC;
+	}
+
+	uint_least32_t frame;
+	double		   clock;
+
+	switch (model) {
+	case SidConfig::PAL:	  frame = 63 * 312; clock = 985248.4;   break;
+	case SidConfig::OLD_NTSC: frame = 64 * 262; clock = 1022727.14; break;
+	case SidConfig::DREAN:	  frame = 65 * 312; clock = 1023440.0;  break;
+	default:				  frame = 65 * 263; clock = 1022727.14; break;
+	}
+
+	const bool cia = (tuneInfo->songSpeed() == SidTuneInfo::SPEED_CIA_1A);
+	const int  sids = std::max(1, tuneInfo->sidChips());
+
+	const uint_least64_t maxCycles = (known ? known : m_maxLength) * clock / 1000;
+	const uint_least64_t silence   = (uint_least64_t)m_silence * m_config.frequency / 1000;
+
+	const bool synthesis = (engine.config().sidEmulation != nullptr);
+
+	short* buffers[3];
+	engine.buffers(buffers);
+
+	SilenceDetector quiet(m_config.frequency);
+	LoopDetector	repeats(LOOP_CONFIRM * clock / 1000);
+
+	Mixer			   mixer;
+	std::vector<short> mixed;
+	const unsigned int channels = (m_config.playback == SidConfig::STEREO) ? 2 : 1;
+
+	if (meter)
+		mixer.initialize(engine.installedSIDs(), channels == 2);
+
+	loop_t found = { 0, 0, clock };
+	uint_least64_t cycles = 0;
+
+	while (cycles < maxCycles) {
+		const uint_least32_t period = (cia && engine.getCia1TimerA()) ?
+			engine.getCia1TimerA() + 1U : frame;
+
+		for (uint_least32_t done = 0; done < period;) {
+			const uint_least32_t step = std::min<uint_least32_t>(2000, period - done);
+
+			const int samples = engine.play(step);
+			if (samples < 0) UNLIKELY
+				return false;
+
+			if (synthesis)
+				quiet.feed(buffers, engine.installedSIDs(), samples);
+
+			if (meter && (samples > 0)) {
+				if (mixed.size() < (size_t)samples * channels)
+					mixed.resize(samples * channels);
+
+				mixer.begin(mixed.data(), samples * channels);
+				mixer.doMix(buffers, samples);
+				meter->feed(mixed.data(), samples);
+			}
+
+			done += step;
+		}
+
+		// What the tune has written to the SIDs and how
+		// fast it's going make up the state of the frame
+		uint_least64_t hash = FNV_OFFSET;
+		for (int i = 0; i < sids; i++) {
+			uint8_t regs[32];
+
+			if (engine.getSidStatus(i, regs)) {
+				for (const uint8_t reg : regs)
+					hash = (hash ^ reg) * FNV_PRIME;
+			}
+		}
+		hash = (hash ^ period) * FNV_PRIME;
+
+		if (known) {
+			cycles += period;
+			continue;
+		}
+
+		if (repeats.feed(hash, cycles, period, found)) {
+			length = found.endMs();
+			if (loop)
+				*loop = found;
+			return true;
+		}
+
+		cycles += period;
+
+		if (synthesis && (quiet.silent() >= silence)) {
+			// Tunes that never make a sound still need a length
+			length = std::max<uint_least64_t>(
+				quiet.lastSound() * 1000 / m_config.frequency, 1000);
+			return true;
+		}
+	}
+
+	if (known)
+		length = known;
+#else
+	// Without a way to step the emulation by frames,
+	// only silence can be looked for
+	(void)tuneInfo;
+	(void)loop;
+	(void)meter;
+	(void)known;
+
+	if (!engine.config().sidEmulation)
+		return true;
+
+	const uint_least32_t rate	= m_config.frequency;
+	const uint_least32_t window = rate / WINDOWS_PER_SEC;
+
+	const uint_least64_t maxSamples = (uint_least64_t)m_maxLength * rate / 1000;
+	const uint_least64_t silence	= (uint_least64_t)m_silence * rate / 1000;
+
+	uint_least64_t position  = 0; // samples so far
+	uint_least64_t lastSound = 0; // end of the last window with sound
+
+	std::vector<short> buffer(window);
+
+	while (position < maxSamples) {
+		if (engine.play(buffer.data(), window) < window) UNLIKELY
+			return false;
+
+		const auto range = std::minmax_element(buffer.begin(), buffer.end());
+
+		position += window;
+		if (*range.second - *range.first > SILENCE_LEVEL)
+			lastSound = position;
+
+		if (position - lastSound >= silence) {
+			length = std::max<uint_least64_t>(lastSound * 1000 / rate, 1000);
+			return true;
+		}
+	}
+#endif
+
+	return true;
+}
+
+std::string Analyzer::formatTime(uint_least32_t ms) {
+	char buffer[32];
+
+	std::snprintf(buffer, sizeof(buffer), "%u:%02u.%03u",
+				  (unsigned int)(ms / 60000),
+				  (unsigned int)(ms / 1000 % 60),
+				  (unsigned int)(ms % 1000));
+
+	return buffer;
+}
+
+void Analyzer::writeSonglengths(std::ostream &out, bool header) const {
+	if (header)
+		out << "[Database]" << '\n';
+
+	for (const tune_t &tune : m_tunes) {
+		out << "; " << tune.path << '\n'
+			<< tune.md5 << '=';
+
+		for (size_t i = 0; i < tune.lengths.size(); i++) {
+			if (i)
+				out << ' ';
+
+			// Use the longest length searched if there was no end
+			out << formatTime(tune.lengths[i] ? tune.lengths[i] : m_maxLength);
+		}
+
+		out << '\n';
+	}
+
+	out.flush();
+}
+
+void Analyzer::writeLoudness(std::ostream &out, bool header) const {
+	if (header)
+		out << "[Loudness]" << '\n';
+
+	for (const tune_t &tune : m_tunes) {
+		out << "; " << tune.path << '\n'
+			<< tune.md5 << '=';
+
+		for (size_t i = 0; i < tune.loudness.size(); i++) {
+			if (i)
+				out << ' ';
+
+			LoudnessDatabase::write(out, tune.loudness[i]);
+		}
+
+		out << '\n';
+	}
+
+	out.flush();
+}
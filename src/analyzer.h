@@ -0,0 +1,170 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2024-2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <sidplayfp/SidConfig.h>
+
+#include "loudness.h"
+
+class sidbuilder;
+class sidplayfp;
+class SidTune;
+class SidDatabase;
+
+/*
+ * Offline analysis of tunes.
+ *
+ * Every subtune is emulated as fast as possible on a pool
+ * of worker threads, each with its own engine, and nothing
+ * is sent to an audio device. Workers get their SID builders
+ * from the player so they sound like it would.
+ *
+ * Besides song lengths, the loudness of every subtune can be
+ * measured through the player's mixer, up to its length from
+ * the songlength database or up to the end that's found.
+ *
+ * A tune ends when it goes silent, or when it starts over:
+ * the SID registers are hashed after every frame and the
+ * earliest stretch that exactly repeats is its loop. Loops
+ * can be found without a SID builder, which is much faster.
+ */
+class Analyzer {
+public:
+	// Must return a builder set up for the given SID model,
+	// or nullptr. It's never called by two workers at once.
+	using builder_factory_t = std::function<sidbuilder*(bool is6581)>;
+
+	// Defaults for the song length search (milliseconds)
+	static constexpr uint_least32_t MAX_LENGTH = 15 * 60 * 1000;
+	static constexpr uint_least32_t SILENCE	= 5000;
+
+	enum mode_t {
+		SONGLENGTHS,
+		LOUDNESS
+	};
+
+	// Where a tune starts repeating itself, in CPU cycles
+	struct loop_t {
+		uint_least64_t start;
+		uint_least64_t length;
+		double		   clock; // cycles per second
+
+		uint_least32_t startMs() const { return start * 1000 / clock; }
+		uint_least32_t endMs() const { return (start + length) * 1000 / clock; }
+	};
+
+private:
+	struct tune_t {
+		std::string path;
+		std::string md5;
+		std::vector<uint_least32_t> lengths; // 0 if no end was found
+		std::vector<LoudnessMeter::result_t> loudness;
+	};
+
+	struct job_t {
+		size_t		 tune;
+		unsigned int song;
+	};
+
+	mode_t			  m_mode;
+	SidConfig		  m_config;
+	builder_factory_t m_factory;
+	std::mutex		  m_factoryLock;
+
+	// Copies, the player frees its own after setting them
+	std::vector<uint8_t> m_kernal;
+	std::vector<uint8_t> m_basic;
+	std::vector<uint8_t> m_chargen;
+
+	bool		   m_filter;
+	uint_least32_t m_maxLength;
+	uint_least32_t m_silence;
+
+	std::vector<tune_t> m_tunes;
+	std::vector<job_t>	m_jobs;
+
+private:
+	static std::string formatTime(uint_least32_t ms);
+
+	static const uint8_t* rom(const std::vector<uint8_t> &data) {
+		return data.empty() ? nullptr : data.data();
+	}
+
+	void worker(size_t &next, std::mutex &lock);
+	bool setup(sidplayfp &engine, SidTune &tune, bool synthesis);
+	bool findEnd(sidplayfp &engine, SidTune &tune, uint_least32_t &length,
+				 loop_t *loop, LoudnessMeter *meter = nullptr);
+
+public:
+	// Without a factory there's no sound, only loops are found
+	Analyzer(const SidConfig &config, builder_factory_t factory = nullptr);
+
+	// ROMs that are missing are left to the engine
+	void setRoms(const uint8_t *kernal, const uint8_t *basic, const uint8_t *chargen) {
+		if (kernal)  m_kernal.assign(kernal, kernal + 8192);
+		if (basic)	 m_basic.assign(basic, basic + 8192);
+		if (chargen) m_chargen.assign(chargen, chargen + 4096);
+	}
+
+	void setFilter(bool enable) { m_filter = enable; }
+
+	// Set before adding files
+	void setMode(mode_t mode) { m_mode = mode; }
+
+	// Longest length to search and how much silence ends a tune
+	void setLimits(uint_least32_t maxLength, uint_least32_t silence) {
+		m_maxLength = maxLength;
+		m_silence	= silence;
+	}
+
+	// Queue every subtune of a file. Song lengths aren't looked
+	// for if the database already has them, while loudness is
+	// measured up to them. Returns false if the file isn't a tune.
+	bool add(const std::string &path, SidDatabase *known = nullptr);
+
+	// Go through every queued subtune, using as many
+	// threads as there are cores
+	void run(void);
+
+	// Write the results in Songlengths.md5 format
+	void writeSonglengths(std::ostream &out, bool header) const;
+
+	// Write the results for the loudness database
+	void writeLoudness(std::ostream &out, bool header) const;
+
+	// Find the loop of a single subtune on this thread, without
+	// SID emulation. Returns false if it doesn't repeat within
+	// the longest length.
+	bool findLoop(const std::string &path, unsigned int song, loop_t &loop);
+
+	size_t tunes(void) const { return m_tunes.size(); }
+};
+
+#endif // ANALYZER_H
@@ -22,6 +22,7 @@
 
 #include "player.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include <cstring>
@@ -132,8 +133,17 @@ void displayDebugArgs() {
 
 	out << "Debug options:" << endl
 		<< "--cpu-debug    display CPU registers and assembly dumps" << endl
+#ifdef FEAT_NEW_PLAY_API
+		<< "--bench        render as fast as possible and print timings" << endl
+		<< "               as JSON on stdout" << endl
+		<< "--fingerprint  same as --bench, but for every subtune and" << endl
+		<< "               with a hash of the rendered audio" << endl
+#endif
 		<< "--delay=<num>  simulate C64 power-on delay (default: random)" << endl
 		<< "--no-audio     no audio output device" << endl
+		<< "--sim-audio[=<ms>]" << endl
+		<< "               simulated sound card, with periods up to" << endl
+		<< "               <ms> late" << endl
 		<< "--no-sid       no SID emulation" << endl
 		<< "--null         no audio output device nor SID emulation" << endl;
 }
@@ -149,6 +159,7 @@ int ConsolePlayer::args(int argc, const char *argv[]) {
 	m_driver.output = OUT_SOUNDCARD;
 	m_driver.file	= false;
 	m_driver.info	= false;
+	m_driver.cache	= m_iniCfg.playercfg().renderCache;
 
 #ifdef FEAT_NEW_PLAY_API
 	m_fadeoutLen = m_iniCfg.playercfg().fadeoutLen;
@@ -201,6 +212,15 @@ int ConsolePlayer::args(int argc, const char *argv[]) {
 				m_engCfg.frequency = (uint32_t) atoi(argv[i]+2);
 			}
 
+#ifdef FEAT_NEW_PLAY_API
+			// Run the emulation at its own rate and resample
+			else if (strncmp(&argv[i][1], "-engine-rate=", 13) == 0) {
+				m_engineRate = (uint_least32_t) atoi(&argv[i][14]);
+				if ((m_engineRate < 8000) || (m_engineRate > 192000))
+					err = true;
+			}
+#endif
+
 			// Disable filter emulation?
 			else if (argv[i][1] == 'f') {
 				m_filter.enabled ? m_filter.enabled = false : m_filter.enabled = true;
@@ -232,6 +252,10 @@ int ConsolePlayer::args(int argc, const char *argv[]) {
 					uint_least8_t precision = atoi(&argv[i][2]);
 					if (precision <= 16)
 						m_bitDepth = 16;
+#ifdef FEAT_NEW_PLAY_API
+					else if (precision <= 24)
+						m_bitDepth = 24;
+#endif
 					else
 						m_bitDepth = 32;
 				}
@@ -312,6 +336,16 @@ int ConsolePlayer::args(int argc, const char *argv[]) {
 				}
 			}
 
+			// Small sound card buffers
+			else if (std::strcmp(&argv[i][1], "-low-latency") == 0) {
+				m_driver.lowLatency = true;
+			}
+
+			// Show and report output statistics
+			else if (std::strcmp(&argv[i][1], "-stats") == 0) {
+				m_driver.stats = true;
+			}
+
 			// enable DigiBoost?
 			else if (std::strcmp(&argv[i][1], "-digiboost") == 0) {
 				m_engCfg.digiBoost = true;
@@ -364,10 +398,89 @@ int ConsolePlayer::args(int argc, const char *argv[]) {
 					m_outfile = &argv[i][2];
 			}
 
+			// Or to a FLAC one
+			else if (strncmp(&argv[i][1], "-flac", 5) == 0) {
+				m_driver.output = OUT_FLAC;
+				m_driver.file	= true;
+
+				if (argv[i][6] == '=')
+					m_outfile = &argv[i][7];
+				else if (argv[i][6] != '\0')
+					err = true;
+			}
+
+			// Or as bare samples, to stdout unless told otherwise
+			else if (strncmp(&argv[i][1], "-raw", 4) == 0) {
+				m_driver.output = OUT_RAW;
+				m_driver.file	= true;
+
+				if (argv[i][5] == '=')
+					m_outfile = &argv[i][6];
+				else if (argv[i][5] == '\0')
+					m_outfile = "-";
+				else
+					err = true;
+			}
+
+#ifdef FEAT_NEW_PLAY_API
+			else if (std::strcmp(&argv[i][1], "-find-loop") == 0) {
+				m_loop.find = true;
+			}
+#endif
+
+			// Lend the sample buffers to the pipe instead of copying
+			else if (std::strcmp(&argv[i][1], "-splice") == 0) {
+				m_driver.splice = true;
+			}
+
+			// Hear what's being recorded
+			else if (std::strcmp(&argv[i][1], "-monitor") == 0) {
+				m_driver.monitor = true;
+			}
+
+			// Every subtune into one file
+			else if (std::strcmp(&argv[i][1], "-album") == 0) {
+				m_album.enabled = true;
+			}
+
+			else if (std::strcmp(&argv[i][1], "-split") == 0) {
+				m_album.enabled = true;
+				m_album.split	= true;
+			}
+
+			else if (strncmp(&argv[i][1], "-songlengths", 12) == 0) {
+				m_analysis.enabled = true;
+
+				if (argv[i][13] == '=')
+					m_analysis.output = &argv[i][14];
+				else if (argv[i][13] != '\0')
+					err = true;
+			}
+
+#ifdef FEAT_NEW_PLAY_API
+			else if (strncmp(&argv[i][1], "-loudness", 9) == 0) {
+				m_analysis.enabled	= true;
+				m_analysis.loudness = true;
+
+				if (argv[i][10] == '=')
+					m_analysis.output = &argv[i][11];
+				else if (argv[i][10] != '\0')
+					err = true;
+			}
+#endif
+
 			else if (strncmp(&argv[i][1], "-info", 5) == 0) {
 				m_driver.info = true;
 			}
 
+			else if (std::strcmp(&argv[i][1], "-cache") == 0) {
+				m_driver.cache = true;
+			}
+
+			else if (std::strcmp(&argv[i][1], "-no-cache") == 0) {
+				m_driver.cache = false;
+			}
+
 #ifdef HAVE_SIDPLAYFP_BUILDERS_RESIDFP_H
 			else if (std::strcmp(&argv[i][1], "-residfp") == 0) {
 				m_driver.sid = EMU_RESIDFP;
@@ -400,20 +513,42 @@ int ConsolePlayer::args(int argc, const char *argv[]) {
 				m_driver.output = OUT_NULL;
 			}
 
+			// Play in real time without a sound card
+			else if (strncmp(&argv[i][1], "-sim-audio", 10) == 0) {
+				m_driver.output = OUT_SIM;
+				m_driver.file	= false;
+
+				if (argv[i][11] == '=')
+					m_driver.jitter = std::max(atof(&argv[i][12]), 0.) * 1000;
+				else if (argv[i][11] != '\0')
+					err = true;
+			}
+
 			else if (std::strcmp(&argv[i][1], "-cpu-debug") == 0) {
 				m_cpudebug = true;
 			}
 
+#ifdef FEAT_NEW_PLAY_API
+			else if (std::strcmp(&argv[i][1], "-bench") == 0) {
+				m_bench.enabled = true;
+			}
+
+			else if (std::strcmp(&argv[i][1], "-fingerprint") == 0) {
+				m_bench.enabled		= true;
+				m_bench.fingerprint = true;
+			}
+#endif
+
 			else {
 				err = true;
 			}
 
 		} else {
-			// Reading the file name
+			// Reading the file name, analysis takes any number
+			m_analysis.files.push_back(argv[i]);
+
 			if (infile == 0)
 				infile = i;
-			else
-				err = true;
 		}
 
 		if (err) {
@@ -424,8 +559,38 @@ int ConsolePlayer::args(int argc, const char *argv[]) {
 		++i;  // next index
 	}
 
+	if (!m_analysis.enabled && (m_analysis.files.size() > 1)) {
+		displayArgs(m_analysis.files[1].c_str());
+		return -1;
+	}
+
 	const char* hvscBase = getenv("HVSC_BASE");
 
+	// Song lengths are found for every file given, skipping
+	// tunes the songlength database already knows
+	if (m_analysis.enabled) {
+		if (m_analysis.files.empty()) {
+			displayArgs();
+			return -1;
+		}
+
+		songlengthDB = false;
+
+		if (hvscBase && tryOpenDatabase(hvscBase)) {
+			songlengthDB = true;
+		} else if ((m_iniCfg.playercfg().database.find(TEXT(".md5")) != SID_STRING::npos)
+			&& m_database.open(m_iniCfg.playercfg().database.c_str())) {
+			songlengthDB = true;
+		}
+
+		if (!m_engine.config(m_engCfg)) {
+			displayError(m_engine.error());
+			return -1;
+		}
+
+		return 1;
+	}
+
 	// Load the tune
 	m_filename = argv[infile];
 	m_tune.load(m_filename.c_str());
@@ -443,14 +608,71 @@ int ConsolePlayer::args(int argc, const char *argv[]) {
 	if (m_outfile != nullptr)
 		m_track.single = true;
 
+	// Benchmarks render a single tune as fast as possible
+	// into a discard sink and report on stdout
+	if (m_bench.enabled) {
+		m_driver.output = OUT_NULL;
+		m_driver.file	= false;
+		m_track.loop	= false;
+		m_quietLevel	= 3;
+
+		// Fingerprints go through every subtune and must be
+		// reproducible, so don't let the power-on delay be random
+		if (!m_bench.fingerprint)
+			m_track.single = true;
+		else if (m_engCfg.powerOnDelay > SidConfig::MAX_POWER_ON_DELAY)
+			m_engCfg.powerOnDelay = 0;
+	}
+
+	// The sound card plays along with a file
+	if (m_driver.monitor && !m_driver.file) {
+		if (!m_bench.enabled)
+			displayError("WARNING: --monitor needs a file output!");
+		m_driver.monitor = false;
+	}
+
+	if (m_driver.splice && (m_driver.output != OUT_RAW)) {
+		displayError("WARNING: --splice only applies to --raw!");
+		m_driver.splice = false;
+	}
+
 	// Can only loop if not creating audio files
 	if (m_driver.output > OUT_SOUNDCARD)
 		m_track.loop = false;
 
-	if (m_driver.info && m_driver.file) {
-		displayError("WARNING: metadata can only be added to WAV files!");
+	// An album goes through all the subtunes, from the first
+	// unless told otherwise
+	if (m_album.enabled) {
+		if (!m_driver.file) {
+			displayError("WARNING: --album and --split need a file output!");
+			m_album.enabled = false;
+			m_album.split	= false;
+		} else {
+			m_track.single = false;
+			if (!m_track.first)
+				m_track.first = 1;
+		}
 	}
 
+	// Only the mixer can give more than 16 bits, and only WAV
+	// files take them as 24-bit integers. Sound cards take 32
+	// bits from the mixer too.
+#ifdef FEAT_NEW_PLAY_API
+	if ((m_bitDepth == 24) && (m_driver.output != OUT_WAV))
+#else
+	if ((m_bitDepth == 24)
+		|| ((m_bitDepth == 32) && (m_driver.output == OUT_SOUNDCARD)))
+#endif
+		m_bitDepth = 16;
+
+	if (m_driver.info && !m_driver.file) {
+		displayError("WARNING: metadata can only be added to WAV or FLAC files!");
+	}
+
+	// ReplayGain tags come from the loudness database
+	if (m_driver.info && !m_iniCfg.playercfg().loudnessDb.empty())
+		m_loudness.open(m_iniCfg.playercfg().loudnessDb);
+
 	// Select the desired track
 	m_track.first	 = m_tune.selectSong(m_track.first);
 	m_track.selected = m_track.first;
@@ -461,14 +683,17 @@ int ConsolePlayer::args(int argc, const char *argv[]) {
 	// If user provided no time then load songlength database
 	// and set default lengths in case it's not found in there.
 	{	// Time of 0 provided for WAV generation?
-		if (m_driver.file && m_timer.valid && !m_timer.length) {
-			displayError("ERROR: can't use -l0 if recording!");
+		const bool fixedLength = m_driver.file || m_bench.enabled;
+
+		if (fixedLength && m_timer.valid && !m_timer.length) {
+			displayError("ERROR: can't use -l0 if recording or benchmarking!");
 			return -1;
 		}
 		if (!m_timer.valid) {
-			m_timer.length = m_driver.file ?
+			m_timer.length = fixedLength ?
 				m_iniCfg.playercfg().recordLength
 				: m_iniCfg.playercfg().playLength;
+			m_timer.defaultLength = m_timer.length;
 
 			songlengthDB = false;
 			if (hvscBase) {
@@ -519,6 +744,11 @@ void ConsolePlayer::displayArgs (const char *arg) {
 		<< "-b<num>           begin playback at [min:]sec[.mil] mark" << endl
 		<< "-r<num>           set sample rate in Hz, defaults to "
 		<< SidConfig::DEFAULT_SAMPLING_FREQ << endl
+#ifdef FEAT_NEW_PLAY_API
+		<< "--engine-rate=<num>" << endl
+		<< "                  run the emulation at <num> Hz and" << endl
+		<< "                  resample to the output rate" << endl
+#endif
 		<< "-D<addr>          set address of SID #2 (e.g. -ds0xd420)" << endl
 		<< "-T<addr>          set address of SID #3 (e.g. -ts0xd440)" << endl
 		<< "-m<num|a-c>       mute voice <num> (e.g. -m1 -m2), use" << endl
@@ -527,9 +757,11 @@ void ConsolePlayer::displayArgs (const char *arg) {
 		<< "                  (default), disable it and vice-versa" << endl
 		<< "-o<l|s>           loop and/or make the tune single track" << endl
 		<< "-o<num>           start track (default: preset)" << endl
-		<< "-d<num>           set depth for file output: 16 for signed" << endl
-		<< "                  16-bit, and 32 for 32-bit float. Defaults" << endl
-		<< "                  to unsigned 16-bit" << endl
+		<< "-d<num>           set sample depth: 16 for signed 16-bit," << endl
+		<< "                  24 for signed 24-bit (WAV only), and 32" << endl
+		<< "                  for 32-bit float, or 32-bit integers on" << endl
+		<< "                  sound cards without float. Defaults" << endl
+		<< "                  to signed 16-bit" << endl
 		<< "-s                use stereo output" << endl
 		<< "-m                use mono output" << endl
 		<< "-l<num>           set play/record length in [min:]sec[.mil]" << endl
@@ -544,6 +776,10 @@ void ConsolePlayer::displayArgs (const char *arg) {
 		<< "-m<o|n>[f]        set SID model to [o]ld (MOS6581) or [n]ew" << endl
 		<< "                  (CSG8580), default defined by the tune. You" << endl
 		<< "                  may [f]orce that setting as well" << endl
+		<< "--low-latency     use the shortest sound card buffer that" << endl
+		<< "                  plays without dropouts" << endl
+		<< "--stats           show underruns and latency while playing," << endl
+		<< "                  and print them as JSON for each subtune" << endl
 		<< "--digiboost       enable the DigiBoost hack for the 8580 chip" << endl
 		<< "-R[i|r][f]        set resampling method, either [i]nterpolate" << endl
 		<< "                  or [r]esample. If you're using reSID, you" << endl
@@ -558,7 +794,34 @@ void ConsolePlayer::displayArgs (const char *arg) {
 		<< "                  1.0)" << endl
 		<< "-w[name]          render tune to a WAV file, with the default" << endl
 		<< "                  name being <file>[subtune].wav" << endl
-		<< "--info            add metadata to WAV file" << endl;
+		<< "--flac[=<name>]   render tune to a FLAC file, same default" << endl
+		<< "                  name with the .flac extension" << endl
+		<< "--raw[=<name>]    write signed 16-bit samples with no header" << endl
+		<< "                  to <name> (default: stdout), for pipes" << endl
+		<< "--splice          hand --raw samples to a pipe without copying," << endl
+		<< "                  only if the reader copies them out with read()" << endl
+		<< "--monitor         play on the sound card while writing the" << endl
+		<< "                  file, from the same emulation" << endl
+		<< "--album           render every subtune back to back into one" << endl
+		<< "                  file, named <file>.wav unless given, with" << endl
+		<< "                  a cue sheet of where each one starts" << endl
+		<< "--split           same as --album, also writing each subtune" << endl
+		<< "                  to a file of its own in the same pass" << endl
+		<< "--info            add metadata to WAV or FLAC file" << endl
+		<< "--[no-]cache      reuse earlier renders of the same tune with" << endl
+		<< "                  the same settings" << endl
+		<< "--songlengths[=<file>] find the length of every subtune of" << endl
+		<< "                  the files given, using all cores, and" << endl
+		<< "                  write Songlengths.md5 entries to <file>" << endl
+		<< "                  (default: stdout). -l sets the longest" << endl
+		<< "                  length searched" << endl;
+#ifdef FEAT_NEW_PLAY_API
+	out << "--find-loop       find where the tune starts over and play" << endl
+		<< "                  up to there, -ol then loops seamlessly" << endl
+		<< "--loudness[=<file>] measure the EBU R128 loudness of every" << endl
+		<< "                  subtune of the files given, in parallel," << endl
+		<< "                  for the loudness database (default: stdout)" << endl;
+#endif
 #ifdef HAVE_SIDPLAYFP_BUILDERS_RESIDFP_H
 	out << "--residfp         use reSIDfp emulation (default)" << endl;
 #endif
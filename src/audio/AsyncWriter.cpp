@@ -0,0 +1,144 @@
+/*
+ * This file is part of C64play, a console SID player.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "AsyncWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+AsyncWriter::AsyncWriter() :
+	m_out(nullptr),
+	m_head(0),
+	m_tail(0),
+	m_count(0),
+	m_stop(false),
+	m_failed(false) {
+	for (block_t &block : m_blocks)
+		block = { nullptr, 0 };
+}
+
+AsyncWriter::~AsyncWriter() {
+	stop();
+
+	for (block_t &block : m_blocks)
+		::operator delete[](block.data, std::align_val_t(ALIGNMENT));
+}
+
+bool AsyncWriter::start(std::ostream *out) {
+	stop();
+
+	try {
+		for (block_t &block : m_blocks) {
+			if (!block.data)
+				block.data = static_cast<char*>(::operator new[](BLOCK_SIZE, std::align_val_t(ALIGNMENT)));
+			block.used = 0;
+		}
+	}
+	catch (std::bad_alloc const &ba) {
+		return false;
+	}
+
+	m_out	 = out;
+	m_head	 = 0;
+	m_tail	 = 0;
+	m_count	 = 0;
+	m_stop	 = false;
+	m_failed = false;
+
+	m_thread = std::thread(&AsyncWriter::run, this);
+	return true;
+}
+
+void AsyncWriter::write(const void *data, size_t size) {
+	const char *bytes = static_cast<const char*>(data);
+
+	while (size) {
+		block_t &block = m_blocks[m_tail];
+
+		const size_t chunk = std::min(size, BLOCK_SIZE - block.used);
+		std::memcpy(block.data + block.used, bytes, chunk);
+
+		block.used += chunk;
+		bytes	   += chunk;
+		size	   -= chunk;
+
+		if (block.used == BLOCK_SIZE)
+			submit();
+	}
+}
+
+// Queue the block being filled and wait for a free one
+void AsyncWriter::submit(void) {
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	m_tail = (m_tail + 1) % BLOCKS;
+	m_count++;
+	m_queued.notify_one();
+
+	m_written.wait(lock, [this] { return m_count < BLOCKS; });
+	m_blocks[m_tail].used = 0;
+}
+
+void AsyncWriter::run(void) {
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	for (;;) {
+		m_queued.wait(lock, [this] { return m_count || m_stop; });
+		if (!m_count)
+			break;
+
+		// The block is ours until the count drops
+		block_t &block = m_blocks[m_head];
+		lock.unlock();
+
+		if (!m_failed) {
+			m_out->write(block.data, block.used);
+			if (m_out->fail())
+				m_failed = true;
+		}
+
+		lock.lock();
+		m_head = (m_head + 1) % BLOCKS;
+		m_count--;
+		m_written.notify_one();
+	}
+}
+
+bool AsyncWriter::stop(void) {
+	if (!m_thread.joinable())
+		return !m_failed;
+
+	if (m_blocks[m_tail].used)
+		submit();
+
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_stop = true;
+	}
+	m_queued.notify_one();
+	m_thread.join();
+
+	m_out->flush();
+	if (m_out->fail())
+		m_failed = true;
+
+	return !m_failed;
+}
@@ -0,0 +1,88 @@
+/*
+ * This file is part of C64play, a console SID player.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ASYNCWRITER_H
+#define ASYNCWRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+/*
+ * Writes to a stream from a thread of its own.
+ *
+ * Data is copied into a ring of large blocks, and full blocks
+ * are handed to the thread, so the caller only waits on the
+ * disk when every block is still queued. Blocks are page
+ * aligned, which is what storage likes best.
+ */
+class AsyncWriter {
+public:
+	static constexpr size_t		  BLOCK_SIZE = 1 << 20;
+	static constexpr unsigned int BLOCKS	 = 8;
+	static constexpr size_t		  ALIGNMENT	 = 4096;
+
+private:
+	struct block_t {
+		char  *data;
+		size_t used;
+	};
+
+	std::ostream *m_out;
+	block_t		  m_blocks[BLOCKS];
+
+	unsigned int m_head;  // next block to write out
+	unsigned int m_tail;  // block being filled
+	unsigned int m_count; // blocks queued
+
+	bool			  m_stop;
+	std::atomic<bool> m_failed;
+
+	std::mutex				m_lock;
+	std::condition_variable m_queued;
+	std::condition_variable m_written;
+	std::thread				m_thread;
+
+private:
+	void run(void);
+	void submit(void);
+
+public:
+	AsyncWriter();
+	~AsyncWriter();
+
+	// Start writing to out, false if the blocks can't be had
+	bool start(std::ostream *out);
+
+	// Queue a copy of the data
+	void write(const void *data, size_t size);
+
+	// Write out whatever is left and wait for it, the stream
+	// can then be used again. False if any write failed.
+	bool stop(void);
+
+	bool running(void) const { return m_thread.joinable(); }
+	bool failed(void) const { return m_failed; }
+};
+
+#endif // ASYNCWRITER_H
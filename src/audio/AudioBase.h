@@ -23,6 +23,7 @@
 #ifndef AUDIOBASE_H
 #define AUDIOBASE_H
 
+#include <chrono>
 #include <string>
 
 #include "IAudio.h"
@@ -46,8 +47,11 @@ private:
 	std::string _errorString;
 
 protected:
+	using stats_clock = std::chrono::steady_clock;
+
 	AudioConfig _settings;
 	short	   *_sampleBuffer;
+	AudioStats	_stats; // backends that keep them
 
 protected:
 	void setError(const char* msg) {
@@ -58,6 +62,13 @@ protected:
 		_errorString.clear();
 	}
 
+	// Account for a write of size samples that started at start
+	void countWrite(uint_least32_t size, stats_clock::time_point start) {
+		_stats.frames  += size / _settings.channels;
+		_stats.blocked += std::chrono::duration_cast<std::chrono::microseconds>(
+			stats_clock::now() - start).count();
+	}
+
 public:
 	AudioBase(const char* name) :
 		_backendName(name),
@@ -73,6 +84,11 @@ public:
 	const char *getErrorString() const override {
 		return _errorString.c_str();
 	}
+
+	AudioStats stats() const override { return _stats; }
+
+	int pollDescriptors(struct pollfd *, int) const override { return 0; }
+	bool ready(struct pollfd *, int) override { return true; }
 };
 
 #endif // AUDIOBASE_H
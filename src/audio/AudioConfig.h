@@ -31,12 +31,27 @@ public:
 	uint8_t  channels;	 // audio channels
 	uint16_t bufSize;	 // sample buffer size
 
+	// 32-bit samples are floats rather than integers. Sound
+	// cards put back which one they took.
+	bool	 floating;
+
+	// Device buffer and period length in microseconds, 0 for the
+	// backend's default. Backends that set them up put back what
+	// they got.
+	uint32_t bufferTime;
+	uint32_t periodTime;
+	bool	 lowLatency; // smallest period that's safe, overrides both
+
 	// defaults
 	AudioConfig() :
 		sampleRate(48000),
 		depth(16),
 		channels(1),
-		bufSize(0) {}
+		bufSize(0),
+		floating(true),
+		bufferTime(0),
+		periodTime(0),
+		lowLatency(false) {}
 };
 
 #endif	// AUDIOCONFIG_H
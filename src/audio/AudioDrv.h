@@ -43,6 +43,9 @@ public:
 	short *buffer() const override { return audio->buffer(); }
 	void getConfig(AudioConfig &cfg) const override { audio->getConfig(cfg); }
 	const char *getErrorString() const override { return audio->getErrorString(); }
+	AudioStats stats() const override { return audio->stats(); }
+	int pollDescriptors(struct pollfd *fds, int space) const override { return audio->pollDescriptors(fds, space); }
+	bool ready(struct pollfd *fds, int count) override { return audio->ready(fds, count); }
 };
 
 #endif // AUDIODRV_H
@@ -26,6 +26,15 @@
 #include <stdint.h>
 
 class AudioConfig;
+struct pollfd;
+
+// What an output went through since it was opened
+struct AudioStats {
+    uint_least64_t frames    = 0; // written
+    uint_least32_t underruns = 0; // times the device ran out of samples
+    uint_least32_t delay     = 0; // frames written but not heard yet
+    uint_least64_t blocked   = 0; // microseconds spent in write()
+};
 
 class IAudio {
 public:
@@ -39,6 +48,14 @@ public:
     virtual short *buffer() const = 0;
     virtual void getConfig(AudioConfig &cfg) const = 0;
     virtual const char *getErrorString() const = 0;
+    virtual AudioStats stats() const = 0;
+
+    // Descriptors to poll() for room in the output, none if
+    // the output only has blocking writes
+    virtual int pollDescriptors(struct pollfd *fds, int space) const = 0;
+    // After poll(), whether a whole buffer can be written
+    // without blocking
+    virtual bool ready(struct pollfd *fds, int count) = 0;
 };
 
 #endif // IAUDIO_H
@@ -23,10 +23,22 @@
 
 #ifdef HAVE_ALSA
 
+#include <algorithm>
+#include <cerrno>
 #include <new>
 
+namespace {
+
+// Frames in a length of time
+snd_pcm_uframes_t frames(uint_least32_t us, unsigned int rate) {
+	return (snd_pcm_uframes_t) ((uint_least64_t) us * rate / 1000000);
+}
+
+}
+
 Audio_ALSA::Audio_ALSA() : AudioBase("ALSA") {
 	// Reset everything.
+	clearError();
 	outOfOrder();
 }
 
@@ -35,9 +47,12 @@ Audio_ALSA::~Audio_ALSA() {
 }
 
 void Audio_ALSA::outOfOrder() {
-	// Reset everything.
-	clearError();
-	_audioHandle = nullptr;
+	// Reset everything, but keep the error for the caller
+	_audioHandle  = nullptr;
+	_localBuffer  = nullptr;
+	_sampleBuffer = nullptr;
+	_mmap		  = false;
+	_mapped		  = false;
 }
 
 void Audio_ALSA::checkResult(int err) {
@@ -60,35 +75,100 @@ bool Audio_ALSA::open(AudioConfig &cfg) {
 
 		checkResult(snd_pcm_hw_params_any(_audioHandle, hw_params));
 
-		checkResult(snd_pcm_hw_params_set_access(_audioHandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED));
+		// Mix right into the ring if we can
+		_mmap = snd_pcm_hw_params_set_access(_audioHandle, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+		if (!_mmap)
+			checkResult(snd_pcm_hw_params_set_access(_audioHandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED));
 
-		checkResult(snd_pcm_hw_params_set_format(_audioHandle, hw_params, SND_PCM_FORMAT_S16_LE));
+		// Samples are in host byte order. For 32 bits float is
+		// best, it's what sound servers mix in.
+		bool formatSet = false;
+		if (cfg.depth == 32) {
+			cfg.floating = true;
+			formatSet = snd_pcm_hw_params_set_format(_audioHandle, hw_params, SND_PCM_FORMAT_FLOAT) == 0;
+			if (!formatSet) {
+				cfg.floating = false;
+				formatSet = snd_pcm_hw_params_set_format(_audioHandle, hw_params, SND_PCM_FORMAT_S32) == 0;
+			}
+		}
+
+		if (!formatSet) {
+			cfg.depth = 16;
+			checkResult(snd_pcm_hw_params_set_format(_audioHandle, hw_params, SND_PCM_FORMAT_S16));
+		}
 
 		checkResult(snd_pcm_hw_params_set_channels(_audioHandle, hw_params, cfg.channels));
 
-		checkResult(snd_pcm_hw_params_set_rate_near(_audioHandle, hw_params, &cfg.sampleRate, nullptr);
+		checkResult(snd_pcm_hw_params_set_rate_near(_audioHandle, hw_params, &cfg.sampleRate, nullptr));
 
-		snd_pcm_uframes_t buffer_size = cfg.sampleRate / 5;
-		checkResult(snd_pcm_hw_params_set_buffer_size_near(_audioHandle, hw_params, &buffer_size));
-		cfg.bufSize = buffer_size;
+		// A period has to fit in the sample buffer
+		const snd_pcm_uframes_t max_period = 0xffff / cfg.channels;
 
-		snd_pcm_uframes_t period_size = buffer_size / 3;
-		checkResult(snd_pcm_hw_params_set_period_size_near(_audioHandle, hw_params, &period_size, nullptr));
+		snd_pcm_uframes_t buffer_size;
+		snd_pcm_uframes_t period_size;
+
+		if (cfg.lowLatency) {
+			// As short as the device allows, but below 2.5 ms
+			// wakeups get too close to the scheduler's noise
+			snd_pcm_uframes_t period_min;
+			checkResult(snd_pcm_hw_params_get_period_size_min(hw_params, &period_min, nullptr));
+
+			period_size = std::min(std::max(period_min, frames(2500, cfg.sampleRate)), max_period);
+			checkResult(snd_pcm_hw_params_set_period_size_near(_audioHandle, hw_params, &period_size, nullptr));
+
+			unsigned int periods = 4;
+			checkResult(snd_pcm_hw_params_set_periods_near(_audioHandle, hw_params, &periods, nullptr));
+		} else {
+			buffer_size = cfg.bufferTime ? frames(cfg.bufferTime, cfg.sampleRate) : cfg.sampleRate / 5;
+			checkResult(snd_pcm_hw_params_set_buffer_size_near(_audioHandle, hw_params, &buffer_size));
+
+			period_size = cfg.periodTime ? frames(cfg.periodTime, cfg.sampleRate) : buffer_size / 3;
+			period_size = std::min(period_size, max_period);
+			checkResult(snd_pcm_hw_params_set_period_size_near(_audioHandle, hw_params, &period_size, nullptr));
+		}
 
 		checkResult(snd_pcm_hw_params(_audioHandle, hw_params));
 
+		checkResult(snd_pcm_hw_params_get_buffer_size(hw_params, &buffer_size));
+		checkResult(snd_pcm_hw_params_get_period_size(hw_params, &period_size, nullptr));
+
+		if (period_size > max_period)
+			throw error("Period too long");
+
+		// Let the player know what it got
+		cfg.bufferTime = (uint_least64_t) buffer_size * 1000000 / cfg.sampleRate;
+		cfg.periodTime = (uint_least64_t) period_size * 1000000 / cfg.sampleRate;
+
 		snd_pcm_hw_params_free(hw_params);
 		hw_params = nullptr;
 
+		// A period at a time, so that it's in one piece in the
+		// ring when mapped, and so that the mixer never gets more
+		// than a buffer ahead of what's heard
+		_period		= period_size;
+		cfg.bufSize = period_size * cfg.channels;
+
 		try {
-			_sampleBuffer = new short[snd_pcm_frames_to_bytes(_audioHandle, buffer_size)/2];
+			_localBuffer = new short[cfg.bufSize * (cfg.depth / 16)];
 		}
 		catch (std::bad_alloc const &ba) {
 			throw error("Unable to allocate memory for sample buffers.");
 		}
+		_sampleBuffer = _localBuffer;
+
+		// Room in the ring is waited for with poll(),
+		// by the player or by us
+		checkResult(snd_pcm_nonblock(_audioHandle, 1));
 
 		// Setup internal Config
 		_settings = cfg;
+		_stats	  = AudioStats();
+
+		if (_mmap && !nextArea()) {
+			close();
+			return false;
+		}
+
 		return true;
 	}
 	catch(error const &e) {
@@ -107,26 +187,180 @@ bool Audio_ALSA::open(AudioConfig &cfg) {
 // reset any variables that reflect the current state.
 void Audio_ALSA::close() {
 	if (_audioHandle != nullptr) {
+		// Blocking again, or closing drops what's left to play
+		snd_pcm_nonblock(_audioHandle, 0);
 		snd_pcm_close(_audioHandle);
-		delete[] _sampleBuffer;
+		delete[] _localBuffer;
 		outOfOrder ();
 	}
 }
 
+bool Audio_ALSA::recover(int err) {
+	if (err == -EPIPE)
+		_stats.underruns++;
+
+	err = snd_pcm_recover(_audioHandle, err, 0);
+	if (err < 0) {
+		setError(snd_strerror(err));
+		return false;
+	}
+	return true;
+}
+
+bool Audio_ALSA::retry(int err) {
+	if (err != -EAGAIN)
+		return recover(err);
+
+	err = snd_pcm_wait(_audioHandle, 1000);
+	return (err >= 0) || recover(err);
+}
+
+bool Audio_ALSA::nextArea() {
+	for (;;) {
+		const snd_pcm_sframes_t avail = snd_pcm_avail_update(_audioHandle);
+		if (avail < 0) {
+			if (!recover(avail))
+				return false;
+			continue;
+		}
+
+		if ((snd_pcm_uframes_t) avail >= _period)
+			break;
+
+		// The ring is full, so start playing it if it's
+		// the first time round
+		if (snd_pcm_state(_audioHandle) == SND_PCM_STATE_PREPARED) {
+			const int err = snd_pcm_start(_audioHandle);
+			if ((err < 0) && !recover(err))
+				return false;
+			continue;
+		}
+
+		// Otherwise use our own buffer for now, ready() maps
+		// the period once poll() says there's room
+		_mapped		  = false;
+		_sampleBuffer = _localBuffer;
+		return true;
+	}
+
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset;
+	snd_pcm_uframes_t frames = _period;
+
+	const int err = snd_pcm_mmap_begin(_audioHandle, &areas, &offset, &frames);
+
+	// Interleaved samples, with the period in one piece
+	_mapped = (err >= 0) && (frames == _period) && (areas[0].first == 0)
+		&& (areas[0].step == _settings.depth * _settings.channels);
+
+	if (_mapped) {
+		_offset		  = offset;
+		_sampleBuffer = (short*) ((char*) areas[0].addr + offset * (areas[0].step / 8));
+	} else
+		_sampleBuffer = _localBuffer;
+
+	return true;
+}
+
+bool Audio_ALSA::writeMapped(uint_least32_t size) {
+	snd_pcm_uframes_t frames = size / _settings.channels;
+
+	if (_mapped) {
+		// The samples are there already
+		const snd_pcm_sframes_t err = snd_pcm_mmap_commit(_audioHandle, _offset, frames);
+		if ((err < 0) && !recover(err))
+			return false;
+	} else {
+		// Past the end of the ring, copy it in two pieces
+		const char *data = (const char*) _localBuffer;
+
+		while (frames) {
+			const snd_pcm_sframes_t written = snd_pcm_mmap_writei(_audioHandle, data, frames);
+			if (written < 0) {
+				if (!retry(written))
+					return false;
+				continue;
+			}
+
+			data   += snd_pcm_frames_to_bytes(_audioHandle, written);
+			frames -= written;
+		}
+	}
+
+	return nextArea();
+}
+
 bool Audio_ALSA::write(uint_least32_t size) {
 	if (_audioHandle == nullptr) {
 		setError("Device not open.");
 		return false;
 	}
 
-	snd_pcm_sframes_t err = snd_pcm_writei(_audioHandle, _sampleBuffer, size);
-	if (err < 0) {
-		err = snd_pcm_recover(_audioHandle, err, 0);
-		if (err < 0) {
-			setError(snd_strerror(err));
-			return false;
+	const stats_clock::time_point start = stats_clock::now();
+
+	if (_mmap) {
+		const bool ok = writeMapped(size);
+		countWrite(size, start);
+		return ok;
+	}
+
+	const char *data = (const char*) _sampleBuffer;
+	snd_pcm_uframes_t frames = size / _settings.channels;
+
+	while (frames) {
+		const snd_pcm_sframes_t written = snd_pcm_writei(_audioHandle, data, frames);
+		if (written < 0) {
+			if (!retry(written))
+				return false;
+			continue;
 		}
+
+		data   += snd_pcm_frames_to_bytes(_audioHandle, written);
+		frames -= written;
 	}
+
+	countWrite(size, start);
+	return true;
+}
+
+AudioStats Audio_ALSA::stats() const {
+	AudioStats stats = _stats;
+
+	snd_pcm_sframes_t delay;
+	if ((_audioHandle != nullptr) && (snd_pcm_delay(_audioHandle, &delay) == 0) && (delay > 0))
+		stats.delay = delay;
+
+	return stats;
+}
+
+int Audio_ALSA::pollDescriptors(struct pollfd *fds, int space) const {
+	if (_audioHandle == nullptr)
+		return 0;
+
+	const int count = snd_pcm_poll_descriptors_count(_audioHandle);
+	if ((count <= 0) || (count > space))
+		return 0;
+
+	return snd_pcm_poll_descriptors(_audioHandle, fds, space);
+}
+
+bool Audio_ALSA::ready(struct pollfd *fds, int count) {
+	unsigned short revents;
+	if (snd_pcm_poll_descriptors_revents(_audioHandle, fds, count, &revents) < 0)
+		return true;
+
+	// Errors are for write() to recover from
+	if (revents & POLLERR)
+		return true;
+
+	// A whole period is free, as avail_min defaults to one
+	if (!(revents & POLLOUT))
+		return false;
+
+	// Mix into the ring again, now that there's room
+	if (_mmap && !_mapped)
+		nextArea();
+
 	return true;
 }
 
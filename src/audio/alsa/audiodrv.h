@@ -38,14 +38,46 @@
 #include "../AudioBase.h"
 
 
+/*
+ * ALSA output.
+ *
+ * Where the device allows it the ring buffer is memory mapped,
+ * and the sample buffer handed out is the next period of the
+ * ring itself, so the mixer writes straight into it. When the
+ * ring can't take a whole period in one piece the samples go
+ * through a buffer of our own instead, and devices without mmap
+ * support are written to with snd_pcm_writei().
+ *
+ * Buffer and period lengths come from the configuration, and
+ * the lengths the device agreed to are put back in it, as are
+ * the sample format's depth and whether it's float.
+ *
+ * The device is non-blocking, so that the player can poll it
+ * along with the keyboard and only write once a period is free.
+ * write() still takes the whole buffer, waiting if it has to.
+ */
 class Audio_ALSA: public AudioBase {
 private:
     snd_pcm_t *_audioHandle;
+    short     *_localBuffer; // ours, when not mixing into the ring
+
+    snd_pcm_uframes_t _period;
+    snd_pcm_uframes_t _offset; // of the area handed out
+    bool _mmap;
+    bool _mapped; // _sampleBuffer points into the ring
 
 private:
     void outOfOrder();
     static void checkResult(int err);
 
+    bool recover(int err);
+    // Wait for the device after -EAGAIN, recover from anything else
+    bool retry(int err);
+
+    // Wait for room for a period and hand it out
+    bool nextArea();
+    bool writeMapped(uint_least32_t size);
+
 public:
     Audio_ALSA();
     ~Audio_ALSA() override;
@@ -55,6 +87,12 @@ public:
     void reset() override {}
     bool write(uint_least32_t size) override;
     void pause() override {}
+
+    // Adds the delay as the device sees it
+    AudioStats stats() const override;
+
+    int pollDescriptors(struct pollfd *fds, int space) const override;
+    bool ready(struct pollfd *fds, int count) override;
 };
 
 #endif // HAVE_ALSA
@@ -0,0 +1,764 @@
+/*
+ * This file is part of C64play, a console SID player.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "FlacFile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <new>
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// Sample size of the stream, side channels take one more bit
+constexpr unsigned int BITS = 16;
+
+// Fixed predictors go up to order 4
+constexpr unsigned int MAX_ORDER = 4;
+
+// Up to 2^8 Rice partitions, each with a 4-bit parameter
+constexpr unsigned int MAX_PARTITION_ORDER = 8;
+constexpr unsigned int MAX_RICE_PARAM	   = 14;
+
+enum subframe_t {
+	CONSTANT,
+	VERBATIM,
+	FIXED
+};
+
+// Channel assignments of a FLAC frame
+enum {
+	LEFT_SIDE  = 8,
+	SIDE_RIGHT = 9,
+	MID_SIDE   = 10
+};
+
+class BitWriter {
+private:
+	std::vector<uint8_t> &m_out;
+	uint_least64_t		  m_acc;
+	unsigned int		  m_bits;
+
+public:
+	BitWriter(std::vector<uint8_t> &out) : m_out(out), m_acc(0), m_bits(0) {}
+
+	void put(uint_least32_t value, unsigned int bits) {
+		if (!bits)
+			return;
+
+		m_acc  = (m_acc << bits) | (value & (0xffffffffU >> (32 - bits)));
+		m_bits += bits;
+
+		while (m_bits >= 8) {
+			m_bits -= 8;
+			m_out.push_back((uint8_t)(m_acc >> m_bits));
+		}
+	}
+
+	// q zeros and a one
+	void unary(uint_least32_t q) {
+		for (; q >= 32; q -= 32)
+			put(0, 32);
+		put(1, q + 1);
+	}
+
+	void align() {
+		if (m_bits)
+			put(0, 8 - m_bits);
+	}
+};
+
+uint8_t crc8(const uint8_t *data, size_t size) {
+	uint8_t crc = 0;
+
+	while (size--) {
+		crc ^= *data++;
+		for (int i = 0; i < 8; i++)
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	}
+
+	return crc;
+}
+
+uint_least16_t crc16(const uint8_t *data, size_t size) {
+	static uint_least16_t table[256];
+	static const bool init = [] {
+		for (unsigned int i = 0; i < 256; i++) {
+			uint_least16_t crc = i << 8;
+			for (int j = 0; j < 8; j++)
+				crc = (crc & 0x8000) ? (uint_least16_t)((crc << 1) ^ 0x8005) : (uint_least16_t)(crc << 1);
+			table[i] = crc;
+		}
+		return true;
+	}();
+	(void)init;
+
+	uint_least16_t crc = 0;
+	while (size--)
+		crc = (uint_least16_t)((crc << 8) ^ table[(crc >> 8) ^ *data++]);
+
+	return crc;
+}
+
+// How a channel is best coded
+struct plan_t {
+	subframe_t		 type;
+	unsigned int	 order;
+	unsigned int	 partitionOrder;
+	uint_least64_t	 bits;
+	std::vector<int_least32_t> residual;
+};
+
+inline uint_least32_t zigzag(int_least32_t r) {
+	return ((uint_least32_t)r << 1) ^ (uint_least32_t)(r >> 31);
+}
+
+void predict(const int_least32_t *x, unsigned int n, unsigned int order, int_least32_t *r) {
+	switch (order) {
+	case 0:
+		for (unsigned int i = 0; i < n; i++)
+			r[i] = x[i];
+		break;
+	case 1:
+		for (unsigned int i = 1; i < n; i++)
+			r[i] = x[i] - x[i-1];
+		break;
+	case 2:
+		for (unsigned int i = 2; i < n; i++)
+			r[i] = x[i] - 2*x[i-1] + x[i-2];
+		break;
+	case 3:
+		for (unsigned int i = 3; i < n; i++)
+			r[i] = x[i] - 3*x[i-1] + 3*x[i-2] - x[i-3];
+		break;
+	case 4:
+		for (unsigned int i = 4; i < n; i++)
+			r[i] = x[i] - 4*x[i-1] + 6*x[i-2] - 4*x[i-3] + x[i-4];
+		break;
+	}
+}
+
+// Best Rice parameter for a partition, and its cost
+unsigned int riceParam(uint_least64_t sum, uint_least32_t count, uint_least64_t &bits) {
+	unsigned int k = 0;
+	while ((k < MAX_RICE_PARAM) && (((uint_least64_t)count << (k + 1)) < sum))
+		k++;
+
+	bits = 4 + (uint_least64_t)count * (k + 1) + (sum >> k);
+	return k;
+}
+
+// Cost of the residual with the best partition order,
+// UINT64_MAX if the block is too short for the order
+uint_least64_t residualBits(const int_least32_t *r, unsigned int n, unsigned int order,
+							unsigned int &partitionOrder) {
+	uint_least64_t best = UINT64_MAX;
+
+	for (unsigned int p = 0; p <= MAX_PARTITION_ORDER; p++) {
+		const unsigned int partitions = 1U << p;
+		if ((n % partitions) || ((n >> p) <= order))
+			break;
+
+		const unsigned int size = n >> p;
+		uint_least64_t total = 6;
+
+		for (unsigned int i = 0; i < partitions; i++) {
+			const unsigned int start = i ? i * size : order;
+			const unsigned int end	 = (i + 1) * size;
+
+			uint_least64_t sum = 0;
+			for (unsigned int j = start; j < end; j++)
+				sum += zigzag(r[j]);
+
+			uint_least64_t bits;
+			riceParam(sum, end - start, bits);
+			total += bits;
+		}
+
+		if (total < best) {
+			best = total;
+			partitionOrder = p;
+		}
+	}
+
+	return best;
+}
+
+void plan(const int_least32_t *x, unsigned int n, unsigned int bps, plan_t &result) {
+	if (std::all_of(x + 1, x + n, [x](int_least32_t s) { return s == x[0]; })) {
+		result.type = CONSTANT;
+		result.bits = 8 + bps;
+		return;
+	}
+
+	result.type = VERBATIM;
+	result.bits = 8 + (uint_least64_t)n * bps;
+
+	std::vector<int_least32_t> r(n);
+
+	for (unsigned int order = 0; (order <= MAX_ORDER) && (order < n); order++) {
+		predict(x, n, order, r.data());
+
+		unsigned int partitionOrder = 0;
+		const uint_least64_t residual = residualBits(r.data(), n, order, partitionOrder);
+		if (residual == UINT64_MAX)
+			break;
+
+		const uint_least64_t bits = 8 + order * bps + residual;
+		if (bits < result.bits) {
+			result.type			  = FIXED;
+			result.order		  = order;
+			result.partitionOrder = partitionOrder;
+			result.bits			  = bits;
+			result.residual.swap(r);
+			r.resize(n);
+		}
+	}
+}
+
+void writeSubframe(BitWriter &out, const int_least32_t *x, unsigned int n,
+				   unsigned int bps, const plan_t &plan) {
+	switch (plan.type) {
+	case CONSTANT:
+		out.put(0x00, 8);
+		out.put(x[0], bps);
+		break;
+
+	case VERBATIM:
+		out.put(0x02, 8);
+		for (unsigned int i = 0; i < n; i++)
+			out.put(x[i], bps);
+		break;
+
+	case FIXED:
+		out.put(0x10 | (plan.order << 1), 8);
+		for (unsigned int i = 0; i < plan.order; i++)
+			out.put(x[i], bps);
+
+		out.put(0, 2); // Rice with 4-bit parameters
+		out.put(plan.partitionOrder, 4);
+
+		const unsigned int partitions = 1U << plan.partitionOrder;
+		const unsigned int size		  = n >> plan.partitionOrder;
+
+		for (unsigned int i = 0; i < partitions; i++) {
+			const unsigned int start = i ? i * size : plan.order;
+			const unsigned int end	 = (i + 1) * size;
+
+			uint_least64_t sum = 0;
+			for (unsigned int j = start; j < end; j++)
+				sum += zigzag(plan.residual[j]);
+
+			uint_least64_t bits;
+			const unsigned int k = riceParam(sum, end - start, bits);
+			out.put(k, 4);
+
+			for (unsigned int j = start; j < end; j++) {
+				const uint_least32_t u = zigzag(plan.residual[j]);
+				out.unary(u >> k);
+				out.put(u, k);
+			}
+		}
+		break;
+	}
+}
+
+void writeUtf8(BitWriter &out, uint_least32_t value) {
+	if (value < 0x80) {
+		out.put(value, 8);
+		return;
+	}
+
+	unsigned int bytes = 2;
+	while ((bytes < 6) && (value >= (1U << (5 * bytes + 1))))
+		bytes++;
+
+	out.put((0xff00 >> bytes) | (value >> (6 * (bytes - 1))), 8);
+	for (unsigned int i = bytes - 1; i > 0; i--)
+		out.put(0x80 | ((value >> (6 * (i - 1))) & 0x3f), 8);
+}
+
+// Frame header code for the rate, 0 to take it from STREAMINFO
+unsigned int rateCode(uint_least32_t rate) {
+	switch (rate) {
+	case 88200:	 return 1;
+	case 176400: return 2;
+	case 192000: return 3;
+	case 8000:	 return 4;
+	case 16000:	 return 5;
+	case 22050:	 return 6;
+	case 24000:	 return 7;
+	case 32000:	 return 8;
+	case 44100:	 return 9;
+	case 48000:	 return 10;
+	case 96000:	 return 11;
+	default:	 return (rate < 65536) ? 13 : 0;
+	}
+}
+
+// The C64 strings are Latin-1, Vorbis comments are UTF-8
+std::string toUtf8(const std::string &latin1) {
+	std::string utf8;
+
+	for (const unsigned char c : latin1) {
+		if (c < 0x80)
+			utf8 += c;
+		else {
+			utf8 += (char)(0xc0 | (c >> 6));
+			utf8 += (char)(0x80 | (c & 0x3f));
+		}
+	}
+
+	return utf8;
+}
+
+void putLittle32(std::vector<uint8_t> &out, uint_least32_t value) {
+	for (int i = 0; i < 4; i++)
+		out.push_back((uint8_t)(value >> (8 * i)));
+}
+
+}
+
+FlacFile::FlacFile(const std::string &name) :
+	AudioBase("FLACFILE"),
+	name(name),
+	file(nullptr),
+	headerWritten(false),
+	channels(0),
+	sampleRate(0),
+	current(0),
+	batchSize(0),
+	job(nullptr),
+	jobNumber(0),
+	busy(0),
+	pending(false),
+	quit(false),
+	frameNumber(0),
+	totalFrames(0),
+	minFrameSize(0),
+	maxFrameSize(0)
+{
+	std::memset(signature, 0, sizeof(signature));
+}
+
+bool FlacFile::open(AudioConfig &cfg) {
+	if (name.empty())
+		return false;
+
+	if (file)
+		close();
+
+	const unsigned long bufSize = cfg.sampleRate * cfg.channels * (BITS>>3);
+	cfg.depth	= BITS;
+	cfg.bufSize = bufSize;
+
+	channels   = cfg.channels;
+	sampleRate = cfg.sampleRate;
+
+	frameNumber	 = 0;
+	totalFrames	 = 0;
+	minFrameSize = 0;
+	maxFrameSize = 0;
+
+	md5.reset();
+	std::memset(signature, 0, sizeof(signature));
+
+	const unsigned int threads = std::max(1U, std::thread::hardware_concurrency());
+	batchSize = (size_t)threads * THREAD_FRAMES * BLOCK_SIZE * channels;
+
+	// We need to make a buffer for the user, the player asks for
+	// cfg.bufSize samples which can be more than a second's worth
+	try {
+		_sampleBuffer = new short[std::max<unsigned long>(bufSize/2, cfg.bufSize)];
+
+		for (batch_t &batch : batches) {
+			batch.samples.clear();
+			batch.samples.reserve(batchSize);
+		}
+	}
+	catch (std::bad_alloc const &ba) {
+		setError("Unable to allocate memory for sample buffers.");
+		return false;
+	}
+
+	current = 0;
+
+	if (name.compare("-") == 0) {
+		file = &std::cout;
+	} else {
+		file = new std::ofstream(name.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+	}
+
+	if (!writer.start(file)) {
+		setError("Unable to allocate memory for write buffers.");
+		return false;
+	}
+
+	headerWritten = false;
+	startWorkers(threads);
+
+	_settings = cfg;
+	_stats	  = AudioStats();
+	return true;
+}
+
+void FlacFile::writeStreamInfo(uint8_t *block) const {
+	const unsigned int blockSize = BLOCK_SIZE;
+
+	block[0] = blockSize >> 8;
+	block[1] = blockSize & 0xff;
+	block[2] = blockSize >> 8;
+	block[3] = blockSize & 0xff;
+
+	block[4] = (minFrameSize >> 16) & 0xff;
+	block[5] = (minFrameSize >> 8) & 0xff;
+	block[6] = minFrameSize & 0xff;
+	block[7] = (maxFrameSize >> 16) & 0xff;
+	block[8] = (maxFrameSize >> 8) & 0xff;
+	block[9] = maxFrameSize & 0xff;
+
+	// 20 bits of rate, 3 of channels, 5 of sample size and
+	// 36 of total frames
+	block[10] = (sampleRate >> 12) & 0xff;
+	block[11] = (sampleRate >> 4) & 0xff;
+	block[12] = ((sampleRate & 0x0f) << 4) | ((channels - 1) << 1) | ((BITS - 1) >> 4);
+	block[13] = (((BITS - 1) & 0x0f) << 4) | ((totalFrames >> 32) & 0x0f);
+	block[14] = (totalFrames >> 24) & 0xff;
+	block[15] = (totalFrames >> 16) & 0xff;
+	block[16] = (totalFrames >> 8) & 0xff;
+	block[17] = totalFrames & 0xff;
+
+	std::memcpy(block + 18, signature, sizeof(signature));
+}
+
+void FlacFile::writeHeader() {
+	// STREAMINFO comes first, and is the last block without tags
+	std::vector<uint8_t> header = { 'f', 'L', 'a', 'C', (uint8_t)(comments.empty() ? 0x80 : 0x00), 0, 0, 34 };
+
+	header.resize(header.size() + 34);
+	writeStreamInfo(&header[8]);
+
+	if (!comments.empty()) {
+		static const char vendor[] = "C64play " VERSION;
+
+		std::vector<uint8_t> block;
+		putLittle32(block, sizeof(vendor) - 1);
+		block.insert(block.end(), vendor, vendor + sizeof(vendor) - 1);
+		putLittle32(block, comments.size());
+
+		for (const std::string &comment : comments) {
+			putLittle32(block, comment.size());
+			block.insert(block.end(), comment.begin(), comment.end());
+		}
+
+		header.push_back(0x84); // last block, VORBIS_COMMENT
+		header.push_back((block.size() >> 16) & 0xff);
+		header.push_back((block.size() >> 8) & 0xff);
+		header.push_back(block.size() & 0xff);
+		header.insert(header.end(), block.begin(), block.end());
+	}
+
+	writer.write(header.data(), header.size());
+	headerWritten = true;
+}
+
+void FlacFile::encode(const batch_t &batch, std::vector<std::vector<uint8_t>> &frames,
+					  unsigned int channels, uint_least32_t sampleRate,
+					  unsigned int thread, unsigned int threads) {
+	const size_t length = batch.samples.size() / channels;
+
+	// Stereo needs room for mid and side too
+	std::vector<int_least32_t> signal[8];
+	plan_t plans[8];
+
+	for (size_t f = thread; f < frames.size(); f += threads) {
+		const size_t	   offset = f * BLOCK_SIZE;
+		const unsigned int n	  = std::min<size_t>(BLOCK_SIZE, length - offset);
+		const short		  *in	  = &batch.samples[offset * channels];
+
+		for (unsigned int c = 0; c < channels; c++) {
+			signal[c].resize(n);
+			for (unsigned int i = 0; i < n; i++)
+				signal[c][i] = in[i * channels + c];
+		}
+
+		unsigned int assignment = channels - 1;
+		const int_least32_t *coded[8];
+		unsigned int bps[8];
+
+		for (unsigned int c = 0; c < channels; c++) {
+			coded[c] = signal[c].data();
+			bps[c]	 = BITS;
+			if (channels != 2)
+				plan(coded[c], n, BITS, plans[c]);
+		}
+
+		// Stereo goes with whichever pair of left, right,
+		// mid and side is smallest
+		if (channels == 2) {
+			signal[2].resize(n);
+			signal[3].resize(n);
+			for (unsigned int i = 0; i < n; i++) {
+				signal[2][i] = (signal[0][i] + signal[1][i]) >> 1;
+				signal[3][i] = signal[0][i] - signal[1][i];
+			}
+
+			plan(signal[0].data(), n, BITS, plans[0]);
+			plan(signal[1].data(), n, BITS, plans[1]);
+			plan(signal[2].data(), n, BITS, plans[2]);
+			plan(signal[3].data(), n, BITS + 1, plans[3]);
+
+			const uint_least64_t independent = plans[0].bits + plans[1].bits;
+			const uint_least64_t leftSide	 = plans[0].bits + plans[3].bits;
+			const uint_least64_t sideRight	 = plans[3].bits + plans[1].bits;
+			const uint_least64_t midSide	 = plans[2].bits + plans[3].bits;
+
+			const uint_least64_t best = std::min({ independent, leftSide, sideRight, midSide });
+
+			if (best == midSide) {
+				assignment = MID_SIDE;
+				std::swap(plans[0], plans[2]);
+				std::swap(plans[1], plans[3]);
+				coded[0] = signal[2].data();
+				coded[1] = signal[3].data();
+				bps[1]	 = BITS + 1;
+			} else if (best == leftSide) {
+				assignment = LEFT_SIDE;
+				std::swap(plans[1], plans[3]);
+				coded[1] = signal[3].data();
+				bps[1]	 = BITS + 1;
+			} else if (best == sideRight) {
+				assignment = SIDE_RIGHT;
+				std::swap(plans[0], plans[3]);
+				coded[0] = signal[3].data();
+				bps[0]	 = BITS + 1;
+			}
+		}
+
+		std::vector<uint8_t> &out = frames[f];
+		out.clear();
+		BitWriter bits(out);
+
+		// Frame header, fixed block size with the frame number
+		const unsigned int rate = rateCode(sampleRate);
+
+		bits.put(0x3ffe, 14);
+		bits.put(0, 2);
+		bits.put(7, 4); // block size - 1 as 16 bits
+		bits.put(rate, 4);
+		bits.put(assignment, 4);
+		bits.put(4, 3); // 16 bits per sample
+		bits.put(0, 1);
+		writeUtf8(bits, batch.first + f);
+		bits.put(n - 1, 16);
+		if (rate == 13)
+			bits.put(sampleRate, 16);
+		bits.put(crc8(out.data(), out.size()), 8);
+
+		for (unsigned int c = 0; c < channels; c++)
+			writeSubframe(bits, coded[c], n, bps[c], plans[c]);
+
+		bits.align();
+		const uint_least16_t crc = crc16(out.data(), out.size());
+		bits.put(crc, 16);
+	}
+}
+
+void FlacFile::startWorkers(unsigned int threads) {
+	quit = false;
+
+	// Whatever number the first job gets is new to them
+	for (unsigned int i = 0; i < threads; i++)
+		workers.emplace_back(&FlacFile::work, this, i, threads, jobNumber);
+}
+
+void FlacFile::stopWorkers() {
+	{
+		std::lock_guard<std::mutex> lock(poolLock);
+		quit = true;
+	}
+	jobReady.notify_all();
+
+	for (std::thread &worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+void FlacFile::work(unsigned int thread, unsigned int threads, unsigned int seen) {
+	std::unique_lock<std::mutex> lock(poolLock);
+
+	for (;;) {
+		jobReady.wait(lock, [this, seen] { return quit || (jobNumber != seen); });
+		if (quit)
+			break;
+
+		seen = jobNumber;
+		batch_t &batch = *job;
+		lock.unlock();
+
+		encode(batch, batch.frames, channels, sampleRate, thread, threads);
+
+		lock.lock();
+		if (--busy == 0)
+			jobDone.notify_one();
+	}
+}
+
+void FlacFile::finishBatch() {
+	if (!pending)
+		return;
+
+	{
+		std::unique_lock<std::mutex> lock(poolLock);
+		jobDone.wait(lock, [this] { return busy == 0; });
+	}
+	pending = false;
+
+	for (const std::vector<uint8_t> &frame : batches[current ^ 1].frames) {
+		const uint_least32_t size = frame.size();
+
+		minFrameSize = minFrameSize ? std::min(minFrameSize, size) : size;
+		maxFrameSize = std::max(maxFrameSize, size);
+
+		writer.write(frame.data(), size);
+	}
+}
+
+void FlacFile::encodeBatch(unsigned int index) {
+	finishBatch();
+
+	batch_t &batch = batches[index];
+
+	const size_t length = batch.samples.size() / channels;
+	batch.first = frameNumber;
+	batch.frames.resize((length + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+	frameNumber += batch.frames.size();
+	totalFrames += length;
+
+	{
+		std::lock_guard<std::mutex> lock(poolLock);
+		job	 = &batch;
+		busy = workers.size();
+		jobNumber++;
+	}
+	pending = true;
+	jobReady.notify_all();
+
+	// The workers only read the samples, so they can be
+	// hashed meanwhile
+	uint8_t bytes[1024];
+	for (size_t i = 0; i < batch.samples.size(); ) {
+		const size_t count = std::min(batch.samples.size() - i, sizeof(bytes) / 2);
+
+		for (size_t j = 0; j < count; j++) {
+			const uint_least16_t sample = static_cast<uint_least16_t>(batch.samples[i + j]);
+			bytes[j * 2]	 = sample & 0xff;
+			bytes[j * 2 + 1] = sample >> 8;
+		}
+
+		md5.update(bytes, count * 2);
+		i += count;
+	}
+
+	current = index ^ 1;
+	batches[current].samples.clear();
+}
+
+bool FlacFile::write(uint_least32_t size) {
+	const stats_clock::time_point start = stats_clock::now();
+	const uint_least32_t total = size;
+
+	if (file && !writer.failed()) {
+		if (!headerWritten)
+			writeHeader();
+
+		const short *samples = _sampleBuffer;
+
+		while (size) {
+			batch_t &batch = batches[current];
+
+			const size_t chunk = std::min<size_t>(size, batchSize - batch.samples.size());
+			batch.samples.insert(batch.samples.end(), samples, samples + chunk);
+
+			samples += chunk;
+			size	-= chunk;
+
+			if (batch.samples.size() == batchSize)
+				encodeBatch(current);
+		}
+	}
+
+	countWrite(total, start);
+	return true;
+}
+
+void FlacFile::close() {
+	if (!file)
+		return;
+
+	if (!writer.failed()) {
+		if (!headerWritten)
+			writeHeader();
+
+		if (!batches[current].samples.empty())
+			encodeBatch(current);
+	}
+	finishBatch();
+	stopWorkers();
+
+	// The stream is only ours again once the writer has stopped
+	const bool written = writer.stop();
+
+	if (file != &std::cout) {
+		// Fill in the lengths and the MD5 now that they're known
+		if (written) {
+			md5.finish(signature);
+
+			uint8_t streamInfo[34];
+			writeStreamInfo(streamInfo);
+
+			file->seekp(8, std::ios::beg);
+			file->write((char*)streamInfo, sizeof(streamInfo));
+		}
+		delete file;
+	}
+
+	file = nullptr;
+	delete[] _sampleBuffer;
+	_sampleBuffer = nullptr;
+}
+
+void FlacFile::setInfo(const char* title, const char* author, const char* released) {
+	comments.push_back("TITLE=" + toUtf8(std::string(title, strnlen(title, 32))));
+	comments.push_back("ARTIST=" + toUtf8(std::string(author, strnlen(author, 32))));
+	comments.push_back("COPYRIGHT=" + toUtf8(std::string(released, strnlen(released, 32))));
+}
+
+void FlacFile::setReplayGain(double gain, double peak) {
+	char buffer[64];
+
+	std::snprintf(buffer, sizeof(buffer), "REPLAYGAIN_TRACK_GAIN=%+.2f dB", gain);
+	comments.push_back(buffer);
+	std::snprintf(buffer, sizeof(buffer), "REPLAYGAIN_TRACK_PEAK=%.6f", peak);
+	comments.push_back(buffer);
+}
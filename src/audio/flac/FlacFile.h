@@ -0,0 +1,135 @@
+/*
+ * This file is part of C64play, a console SID player.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef FLAC_FILE_H
+#define FLAC_FILE_H
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../AudioBase.h"
+#include "../AsyncWriter.h"
+#include "md5.h"
+
+/*
+ * FLAC output file type.
+ *
+ * A small encoder of its own, so there's nothing to link
+ * against: fixed predictors with partitioned Rice coding and
+ * stereo decorrelation, which is where most of the gain is for
+ * SID tunes anyway. Frames don't depend on each other, so a
+ * batch of them is encoded on a pool of threads, kept for as
+ * long as the file is open, while the next one is being filled.
+ *
+ * Only signed 16-bit samples are written, whatever the bit depth.
+ * The MD5 of the audio is worked out as batches are handed to
+ * the pool and filled in at the end along with the lengths,
+ * which can't be done when writing to stdout.
+ */
+class FlacFile: public AudioBase {
+public:
+	static constexpr unsigned int BLOCK_SIZE	= 4096; // frames per FLAC frame
+	static constexpr unsigned int THREAD_FRAMES = 16;	// FLAC frames per thread and batch
+
+private:
+	struct batch_t {
+		std::vector<short> samples;
+		uint_least32_t	   first; // number of the first FLAC frame
+		std::vector<std::vector<uint8_t>> frames;
+	};
+
+	std::string name;
+
+	// Vorbis comments, as FIELD=value in UTF-8
+	std::vector<std::string> comments;
+
+	std::ostream *file;
+	AsyncWriter	  writer;
+	bool headerWritten;
+
+	unsigned int   channels;
+	uint_least32_t sampleRate;
+
+	// One batch is filled while the other is encoded
+	batch_t		   batches[2];
+	unsigned int   current;
+	size_t		   batchSize; // samples
+
+	// Workers live as long as the file is open, and each
+	// encodes every so many frames of the batch handed out
+	std::vector<std::thread> workers;
+	std::mutex				 poolLock;
+	std::condition_variable	 jobReady;
+	std::condition_variable	 jobDone;
+	batch_t		*job;
+	unsigned int jobNumber; // batches handed out so far
+	unsigned int busy;		// workers still on the current one
+	bool		 pending;	// a batch is being encoded
+	bool		 quit;
+
+	uint_least32_t frameNumber;
+	uint_least64_t totalFrames; // per channel
+	uint_least32_t minFrameSize;
+	uint_least32_t maxFrameSize;
+
+	// Of the samples as little-endian bytes, zero until closed
+	MD5		md5;
+	uint8_t signature[MD5::DIGEST_LENGTH];
+
+private:
+	void writeHeader();
+	void writeStreamInfo(uint8_t *block) const;
+
+	// Wait for the batch being encoded and write it out
+	void finishBatch();
+	void encodeBatch(unsigned int batch);
+
+	void startWorkers(unsigned int threads);
+	void stopWorkers();
+	void work(unsigned int thread, unsigned int threads, unsigned int seen);
+
+	static void encode(const batch_t &batch, std::vector<std::vector<uint8_t>> &frames,
+					   unsigned int channels, uint_least32_t sampleRate,
+					   unsigned int thread, unsigned int threads);
+
+public:
+	FlacFile(const std::string &name);
+	~FlacFile() override { close(); }
+
+	static const char *extension() { return ".flac"; }
+
+	bool open(AudioConfig &cfg) override;
+	bool write(uint_least32_t size) override;
+	void close() override;
+	void pause() override {}
+	void reset() override {}
+
+	// Both written as Vorbis comments
+	void setInfo(const char* title, const char* author, const char* released);
+	void setReplayGain(double gain, double peak);
+};
+
+#endif /* FLAC_FILE_H */
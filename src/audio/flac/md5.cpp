@@ -0,0 +1,143 @@
+/*
+ * This file is part of C64play, a console SID player.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "md5.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Shift amounts of every step
+const unsigned int SHIFTS[64] = {
+	7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+	5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+	4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+	6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+// floor(abs(sin(i + 1)) * 2^32)
+const uint_least32_t SINES[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+inline uint_least32_t rotate(uint_least32_t value, unsigned int bits) {
+	value &= 0xffffffff;
+	return ((value << bits) | (value >> (32 - bits))) & 0xffffffff;
+}
+
+}
+
+void MD5::reset() {
+	m_state[0] = 0x67452301;
+	m_state[1] = 0xefcdab89;
+	m_state[2] = 0x98badcfe;
+	m_state[3] = 0x10325476;
+	m_length   = 0;
+}
+
+void MD5::transform(const uint8_t *block) {
+	uint_least32_t words[16];
+	for (unsigned int i = 0; i < 16; i++) {
+		words[i] = (uint_least32_t)block[i * 4]
+			| ((uint_least32_t)block[i * 4 + 1] << 8)
+			| ((uint_least32_t)block[i * 4 + 2] << 16)
+			| ((uint_least32_t)block[i * 4 + 3] << 24);
+	}
+
+	uint_least32_t a = m_state[0];
+	uint_least32_t b = m_state[1];
+	uint_least32_t c = m_state[2];
+	uint_least32_t d = m_state[3];
+
+	for (unsigned int i = 0; i < 64; i++) {
+		uint_least32_t f;
+		unsigned int   g;
+
+		switch (i >> 4) {
+		case 0:	 f = (b & c) | (~b & d); g = i;				   break;
+		case 1:	 f = (d & b) | (~d & c); g = (5 * i + 1) & 15; break;
+		case 2:	 f = b ^ c ^ d;			 g = (3 * i + 5) & 15; break;
+		default: f = c ^ (b | ~d);		 g = (7 * i) & 15;	   break;
+		}
+
+		const uint_least32_t next = d;
+		d = c;
+		c = b;
+		b = (b + rotate(a + f + SINES[i] + words[g], SHIFTS[i])) & 0xffffffff;
+		a = next;
+	}
+
+	m_state[0] = (m_state[0] + a) & 0xffffffff;
+	m_state[1] = (m_state[1] + b) & 0xffffffff;
+	m_state[2] = (m_state[2] + c) & 0xffffffff;
+	m_state[3] = (m_state[3] + d) & 0xffffffff;
+}
+
+void MD5::update(const uint8_t *data, size_t length) {
+	size_t used = m_length % sizeof(m_block);
+	m_length += length;
+
+	// Top up a block left over from last time
+	if (used) {
+		const size_t count = std::min(length, sizeof(m_block) - used);
+		std::memcpy(m_block + used, data, count);
+
+		data   += count;
+		length -= count;
+		used   += count;
+
+		if (used < sizeof(m_block))
+			return;
+
+		transform(m_block);
+	}
+
+	for (; length >= sizeof(m_block); length -= sizeof(m_block), data += sizeof(m_block))
+		transform(data);
+
+	std::memcpy(m_block, data, length);
+}
+
+void MD5::finish(uint8_t digest[DIGEST_LENGTH]) {
+	const uint_least64_t bits = m_length * 8;
+
+	// A one bit, zeros up to 56 bytes into a block, then the length
+	uint8_t padding[72] = { 0x80 };
+	const size_t used = m_length % sizeof(m_block);
+	const size_t count = (used < 56) ? (56 - used) : (120 - used);
+
+	for (unsigned int i = 0; i < 8; i++)
+		padding[count + i] = (uint8_t)(bits >> (8 * i));
+
+	update(padding, count + 8);
+
+	for (unsigned int i = 0; i < 4; i++) {
+		for (unsigned int j = 0; j < 4; j++)
+			digest[i * 4 + j] = (uint8_t)(m_state[i] >> (8 * j));
+	}
+}
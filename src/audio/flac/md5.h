@@ -0,0 +1,53 @@
+/*
+ * This file is part of C64play, a console SID player.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MD5_H
+#define MD5_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * MD5 as in RFC 1321, which FLAC keeps of the audio in
+ * STREAMINFO so that decoders can check what they get.
+ */
+class MD5 {
+public:
+	static constexpr unsigned int DIGEST_LENGTH = 16;
+
+private:
+	uint_least32_t m_state[4];
+	uint_least64_t m_length; // bytes so far
+	uint8_t		   m_block[64];
+
+private:
+	void transform(const uint8_t *block);
+
+public:
+	MD5() { reset(); }
+
+	void reset();
+	void update(const uint8_t *data, size_t length);
+
+	// Pads the message, the digest is only good once
+	void finish(uint8_t digest[DIGEST_LENGTH]);
+};
+
+#endif // MD5_H
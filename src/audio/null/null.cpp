@@ -21,9 +21,12 @@
 
 #include "null.h"
 
-Audio_Null::Audio_Null() :
+#include <new>
+
+Audio_Null::Audio_Null(bool discard) :
 	AudioBase("NULL"),
-	isOpen(false) {}
+	isOpen(false),
+	discard(discard) {}
 
 Audio_Null::~Audio_Null() {
 	close();
@@ -35,6 +38,19 @@ bool Audio_Null::open(AudioConfig &cfg) {
 		return false;
 	}
 
+	if (discard) {
+		// 100ms worth of samples, same as a typical sound card period
+		cfg.bufSize = cfg.sampleRate / 10 * cfg.channels;
+
+		try {
+			_sampleBuffer = new short[cfg.bufSize];
+		}
+		catch (std::bad_alloc const &ba) {
+			setError("Unable to allocate memory for sample buffers.");
+			return false;
+		}
+	}
+
 	isOpen	  = true;
 	_settings = cfg;
 	return true;
@@ -53,5 +69,7 @@ void Audio_Null::close(void) {
 	if (!isOpen)
 		return;
 
+	delete[] _sampleBuffer;
+	_sampleBuffer = nullptr;
 	isOpen = false;
 }
@@ -30,14 +30,17 @@
 #include "../AudioBase.h"
 
 /*
- * Null audio driver, used for songlength detection
+ * Null audio driver, used for songlength detection.
+ * When created as a discard sink it also hands out a buffer,
+ * so that the mixer runs exactly as it would for a real device.
  */
 class Audio_Null: public AudioBase {
 private:
 	bool isOpen;
+	bool discard; // mix into a scratch buffer and throw it away
 
 public:
-	Audio_Null();
+	Audio_Null(bool discard = false);
 	~Audio_Null() override;
 
 	bool open (AudioConfig &cfg) override;
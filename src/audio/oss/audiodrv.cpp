@@ -25,19 +25,32 @@
 
 #include <cstdio>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <cstring>
 
+#include <algorithm>
 #include <new>
 
+namespace {
+
+// Bytes in a length of time
+unsigned int bytes(uint_least32_t us, unsigned int rate, unsigned int frameBytes) {
+	return (unsigned int) ((uint_least64_t) us * rate / 1000000) * frameBytes;
+}
+
+}
+
 #if defined(HAVE_NETBSD)
 const char Audio_OSS::AUDIODEVICE[] = "/dev/audio";
 #else
 const char Audio_OSS::AUDIODEVICE[] = "/dev/dsp";
 #endif
 
-Audio_OSS::Audio_OSS() : AudioBase("OSS") {
+Audio_OSS::Audio_OSS() :
+	AudioBase("OSS"),
+	m_underruns(0) {
 	// Reset everything.
 	outOfOrder();
 }
@@ -67,9 +80,28 @@ bool Audio_OSS::open(AudioConfig &cfg) {
 			throw error("Could not open audio device.");
 		}
 
-		int format = AFMT_S16_LE;
-		if (ioctl(m_audiofd, SNDCTL_DSP_SETFMT, &format) == (-1)) {
-			throw error("Could not set sample format.");
+		// Samples are in host byte order. OSS 4 knows 32-bit
+		// formats, float first as that's what mixers work in.
+		bool formatSet = false;
+#if defined(AFMT_FLOAT) && defined(AFMT_S32_NE)
+		if (cfg.depth == 32) {
+			for (const int wanted : { AFMT_FLOAT, AFMT_S32_NE }) {
+				int format = wanted;
+				if ((ioctl(m_audiofd, SNDCTL_DSP_SETFMT, &format) != -1) && (format == wanted)) {
+					cfg.floating = (format == AFMT_FLOAT);
+					formatSet = true;
+					break;
+				}
+			}
+		}
+#endif
+
+		if (!formatSet) {
+			int format = AFMT_S16_NE;
+			if (ioctl(m_audiofd, SNDCTL_DSP_SETFMT, &format) == (-1)) {
+				throw error("Could not set sample format.");
+			}
+			cfg.depth = 16;
 		}
 
 		// Set mono/stereo.
@@ -92,12 +124,38 @@ bool Audio_OSS::open(AudioConfig &cfg) {
 			throw error("Could not set sample rate.");
 		}
 
-		int temp = 0;
-		ioctl(m_audiofd, SNDCTL_DSP_GETBLKSIZE, &temp);
-		cfg.bufSize = (uint_least32_t) temp;
+		const unsigned int sampleBytes = cfg.depth / 8;
+		const unsigned int frameBytes  = sampleBytes * cfg.channels;
+
+		// Before the first write, or the driver picks for us
+		setFragments(cfg, frameBytes);
+
+		int fragSize = 0;
+		int fragments = 0;
+
+		audio_buf_info info;
+		if (ioctl(m_audiofd, SNDCTL_DSP_GETOSPACE, &info) != -1) {
+			fragSize  = info.fragsize;
+			fragments = info.fragstotal;
+		} else
+			ioctl(m_audiofd, SNDCTL_DSP_GETBLKSIZE, &fragSize);
+
+		if (fragSize <= 0) {
+			throw error("Could not get the fragment size.");
+		}
+
+		// Let the player know what it got
+		if (fragments > 0) {
+			cfg.bufferTime = (uint_least64_t) fragments * fragSize / frameBytes * 1000000 / cfg.sampleRate;
+			cfg.periodTime = (uint_least64_t) fragSize / frameBytes * 1000000 / cfg.sampleRate;
+		}
+
+		// A fragment's worth of samples, as far as the buffer allows
+		const uint_least32_t maxSize = 0xffff / cfg.channels * cfg.channels;
+		cfg.bufSize = std::min<uint_least32_t>(fragSize / sampleBytes, maxSize);
 
 		try {
-			_sampleBuffer = new short[cfg.bufSize];
+			_sampleBuffer = new short[cfg.bufSize * (cfg.depth / 16)];
 		}
 		catch (std::bad_alloc const &ba) {
 			throw error("Unable to allocate memory for sample buffers.");
@@ -105,6 +163,8 @@ bool Audio_OSS::open(AudioConfig &cfg) {
 
 		// Setup internal Config
 		_settings = cfg;
+		_stats	  = AudioStats();
+		m_underruns = 0;
 		return true;
 	}
 	catch(error const &e) {
@@ -119,6 +179,34 @@ bool Audio_OSS::open(AudioConfig &cfg) {
 	}
 }
 
+void Audio_OSS::setFragments(const AudioConfig &cfg, unsigned int frameBytes) {
+	unsigned int bufferBytes;
+	unsigned int periodBytes;
+
+	if (cfg.lowLatency) {
+		// 2.5 ms periods, four of them
+		periodBytes = bytes(2500, cfg.sampleRate, frameBytes);
+		bufferBytes = periodBytes * 4;
+	} else {
+		// 200 ms in thirds unless told otherwise, as with ALSA,
+		// rather than whatever the kernel defaults to
+		bufferBytes = bytes(cfg.bufferTime ? cfg.bufferTime : 200000, cfg.sampleRate, frameBytes);
+		periodBytes = cfg.periodTime ? bytes(cfg.periodTime, cfg.sampleRate, frameBytes) : bufferBytes / 3;
+	}
+
+	// Nearest power of two, 16 bytes at least
+	unsigned int shift = 4;
+	while ((shift < 16) && ((1u << shift) + (1u << (shift - 1)) <= periodBytes))
+		shift++;
+
+	const unsigned int size  = 1u << shift;
+	const unsigned int count = std::min(std::max((bufferBytes + size - 1) / size, 2u), 0x7fffu);
+
+	// Just a hint, what we got is asked for afterwards
+	int fragment = (count << 16) | shift;
+	ioctl(m_audiofd, SNDCTL_DSP_SETFRAGMENT, &fragment);
+}
+
 // Close an opened audio device, free any allocated buffers and
 // reset any variables that reflect the current state.
 void Audio_OSS::close() {
@@ -141,11 +229,61 @@ bool Audio_OSS::write(uint_least32_t size) {
 		return false;
 	}
 
-	if (::write(m_audiofd, _sampleBuffer, 2 * size) < 0) {
+	const stats_clock::time_point start = stats_clock::now();
+
+	if (::write(m_audiofd, _sampleBuffer, size * (_settings.depth / 8)) < 0) {
 		setError(strerror(errno));
 		return false;
-	} else
-		return true;
+	}
+
+	countWrite(size, start);
+	return true;
+}
+
+AudioStats Audio_OSS::stats() const {
+	AudioStats stats = _stats;
+
+	if (m_audiofd == -1)
+		return stats;
+
+	const unsigned int frameBytes = (_settings.depth / 8) * _settings.channels;
+
+	// What's queued, or failing that how full the buffer is
+	int queued = -1;
+#ifdef SNDCTL_DSP_GETODELAY
+	if (ioctl(m_audiofd, SNDCTL_DSP_GETODELAY, &queued) == -1)
+		queued = -1;
+#endif
+	if (queued < 0) {
+		audio_buf_info info;
+		if (ioctl(m_audiofd, SNDCTL_DSP_GETOSPACE, &info) != -1)
+			queued = info.fragstotal * info.fragsize - info.bytes;
+	}
+
+	if (queued > 0)
+		stats.delay = queued / frameBytes;
+
+#ifdef SNDCTL_DSP_GETERROR
+	audio_errinfo errors;
+	if (ioctl(m_audiofd, SNDCTL_DSP_GETERROR, &errors) != -1)
+		m_underruns += errors.play_underruns;
+	stats.underruns = m_underruns;
+#endif
+
+	return stats;
+}
+
+int Audio_OSS::pollDescriptors(struct pollfd *fds, int space) const {
+	if ((m_audiofd == -1) || (space < 1))
+		return 0;
+
+	fds[0].fd	  = m_audiofd;
+	fds[0].events = POLLOUT;
+	return 1;
+}
+
+bool Audio_OSS::ready(struct pollfd *fds, int) {
+	return fds[0].revents & (POLLOUT | POLLERR);
 }
 
 #endif // HAVE_OSS
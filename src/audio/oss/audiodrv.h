@@ -53,14 +53,25 @@
 
 /*
  * Open Sound System (OSS) specific audio driver interface.
+ *
+ * The buffer and period lengths from the configuration are
+ * turned into a fragment count and size, which OSS wants as a
+ * power of two in bytes. A write is one fragment, and what the
+ * driver settled on is put back in the configuration.
  */
 class Audio_OSS: public AudioBase {
 private:
 	static const char AUDIODEVICE[];
 	int    m_audiofd;
 
+	// GETERROR clears the driver's counts, they add up here
+	mutable uint_least32_t m_underruns;
+
 	void outOfOrder();
 
+	// Ask for fragments close to the configured lengths
+	void setFragments(const AudioConfig &cfg, unsigned int frameBytes);
+
 public:
 	Audio_OSS ();
 	~Audio_OSS() override;
@@ -70,6 +81,13 @@ public:
 	void reset() override;
 	bool write(uint_least32_t size) override;
 	void pause() override {}
+
+	// Adds what the driver knows about the delay and underruns
+	AudioStats stats() const override;
+
+	// The device is writable once a fragment is free
+	int pollDescriptors(struct pollfd *fds, int space) const override;
+	bool ready(struct pollfd *fds, int count) override;
 };
 
 #endif // HAVE_*_SOUNDCARD_H
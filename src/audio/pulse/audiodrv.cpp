@@ -22,11 +22,20 @@
 
 #include "audiodrv.h"
 
+#include <algorithm>
 #include <new>
-#include <pulse/error.h>
+
+namespace {
+
+// Lengths used with --low-latency, in microseconds
+constexpr pa_usec_t LOW_LATENCY_BUFFER = 10000;
+constexpr pa_usec_t LOW_LATENCY_PERIOD = 2500;
+
+}
 
 Audio_Pulse::Audio_Pulse() :
 	AudioBase("PULSE") {
+	clearError();
 	outOfOrder();
 }
 
@@ -35,56 +44,158 @@ Audio_Pulse::~Audio_Pulse() {
 }
 
 void Audio_Pulse::outOfOrder() {
+	_mainloop	  = nullptr;
+	_context	  = nullptr;
+	_stream		  = nullptr;
 	_sampleBuffer = nullptr;
-	clearError();
+}
+
+const char *Audio_Pulse::lastError() const {
+	return pa_strerror(pa_context_errno(_context));
+}
+
+// Wake up whoever waits on the mainloop, for every change
+void Audio_Pulse::contextState(pa_context *, void *userdata) {
+	pa_threaded_mainloop_signal(static_cast<Audio_Pulse*>(userdata)->_mainloop, 0);
+}
+
+void Audio_Pulse::streamState(pa_stream *, void *userdata) {
+	pa_threaded_mainloop_signal(static_cast<Audio_Pulse*>(userdata)->_mainloop, 0);
+}
+
+void Audio_Pulse::streamRequest(pa_stream *, size_t, void *userdata) {
+	pa_threaded_mainloop_signal(static_cast<Audio_Pulse*>(userdata)->_mainloop, 0);
+}
+
+// Runs on the mainloop, which holds the lock
+void Audio_Pulse::streamUnderflow(pa_stream *, void *userdata) {
+	static_cast<Audio_Pulse*>(userdata)->_stats.underruns++;
+}
+
+// Called with the mainloop locked
+bool Audio_Pulse::connect(const AudioConfig &cfg) {
+	pa_context_set_state_callback(_context, &contextState, this);
+
+	if (pa_context_connect(_context, nullptr, PA_CONTEXT_NOFLAGS, nullptr) < 0)
+		return false;
+
+	for (;;) {
+		const pa_context_state_t state = pa_context_get_state(_context);
+		if (state == PA_CONTEXT_READY)
+			break;
+		if (!PA_CONTEXT_IS_GOOD(state))
+			return false;
+		pa_threaded_mainloop_wait(_mainloop);
+	}
+
+	_stream = pa_stream_new(_context, "Playing", &_spec, nullptr);
+	if (!_stream)
+		return false;
+
+	pa_stream_set_state_callback(_stream, &streamState, this);
+	pa_stream_set_write_callback(_stream, &streamRequest, this);
+	pa_stream_set_underflow_callback(_stream, &streamUnderflow, this);
+
+	// Anything not asked for is left to the server
+	pa_buffer_attr attr;
+	attr.maxlength = (uint32_t) -1;
+	attr.tlength   = (uint32_t) -1;
+	attr.prebuf	   = (uint32_t) -1;
+	attr.minreq	   = (uint32_t) -1;
+	attr.fragsize  = (uint32_t) -1;
+
+	const pa_usec_t bufferTime = cfg.lowLatency ? LOW_LATENCY_BUFFER : cfg.bufferTime;
+	const pa_usec_t periodTime = cfg.lowLatency ? LOW_LATENCY_PERIOD : cfg.periodTime;
+
+	if (bufferTime)
+		attr.tlength = pa_usec_to_bytes(bufferTime, &_spec);
+	if (periodTime)
+		attr.minreq	 = pa_usec_to_bytes(periodTime, &_spec);
+
+	// Have the server keep the whole latency within tlength
+	int flags = PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE;
+	if (bufferTime)
+		flags |= PA_STREAM_ADJUST_LATENCY;
+
+	if (pa_stream_connect_playback(_stream, nullptr, &attr, (pa_stream_flags_t) flags,
+								   nullptr, nullptr) < 0)
+		return false;
+
+	for (;;) {
+		const pa_stream_state_t state = pa_stream_get_state(_stream);
+		if (state == PA_STREAM_READY)
+			return true;
+		if (!PA_STREAM_IS_GOOD(state))
+			return false;
+		pa_threaded_mainloop_wait(_mainloop);
+	}
 }
 
 bool Audio_Pulse::open(AudioConfig &cfg) {
-	pa_sample_spec pacfg = {};
-
-	pacfg.channels = cfg.channels;
-	pacfg.rate	   = cfg.sampleRate;
-	pacfg.format   = PA_SAMPLE_S16LE;
-
-	// Set bit depth and encoding type.
-	int err;
-	_audioHandle = pa_simple_new(
-		nullptr,
-		"C64play",
-		PA_STREAM_PLAYBACK,
-		nullptr,
-		"Playing",
-		&pacfg,
-		nullptr,
-		nullptr,
-		&err
-	);
+	_spec.channels = cfg.channels;
+	_spec.rate	   = cfg.sampleRate;
+	// The server mixes in float, so that's what 32 bits are
+	if (cfg.depth == 32) {
+		_spec.format = PA_SAMPLE_FLOAT32NE;
+		cfg.floating = true;
+	} else {
+		_spec.format = PA_SAMPLE_S16NE;
+		cfg.depth	 = 16;
+	}
 
 	try {
-		if (! _audioHandle) {
-			throw error(pa_strerror(err));
+		if (_mainloop != nullptr) {
+			throw error("Device already in use");
+		}
+
+		_mainloop = pa_threaded_mainloop_new();
+		if (!_mainloop) {
+			throw error("Unable to create the mainloop.");
+		}
+
+		_context = pa_context_new(pa_threaded_mainloop_get_api(_mainloop), "C64play");
+		if (!_context) {
+			throw error("Unable to create the context.");
+		}
+
+		if (pa_threaded_mainloop_start(_mainloop) < 0) {
+			throw error("Unable to start the mainloop.");
+		}
+
+		pa_threaded_mainloop_lock(_mainloop);
+		const bool connected = connect(cfg);
+
+		const pa_buffer_attr *attr = connected ? pa_stream_get_buffer_attr(_stream) : nullptr;
+		if (attr) {
+			// Let the player know what it got
+			cfg.bufferTime = pa_bytes_to_usec(attr->tlength, &_spec);
+			cfg.periodTime = pa_bytes_to_usec(attr->minreq, &_spec);
+
+			// Writes of a request each, as far as the buffer allows
+			const uint_least32_t maxSize = 0xffff / cfg.channels * cfg.channels;
+			cfg.bufSize = std::min<uint_least32_t>(attr->minreq / pa_sample_size(&_spec), maxSize);
 		}
+		pa_threaded_mainloop_unlock(_mainloop);
 
-		cfg.bufSize = 4096;
+		if (!connected || !attr) {
+			throw error(lastError());
+		}
 
 		try {
-			_sampleBuffer = new short[cfg.bufSize];
+			_sampleBuffer = new short[cfg.bufSize * (cfg.depth / 16)];
 		}
 		catch (std::bad_alloc const &ba) {
 			throw error("Unable to allocate memory for sample buffers!");
 		}
 
 		_settings = cfg;
+		_stats	  = AudioStats();
 
 		return true;
 	}
 	catch(error const  &e) {
 		setError(e.message());
-
-		if (_audioHandle)
-			pa_simple_free(_audioHandle);
-
-		_audioHandle = nullptr;
+		close();
 
 		return false;
 	}
@@ -93,29 +204,97 @@ bool Audio_Pulse::open(AudioConfig &cfg) {
 // Close an opened audio device, free any allocated buffers and
 // reset any variables that reflect the current state.
 void Audio_Pulse::close() {
-	if (_audioHandle != nullptr) {
-		pa_simple_free(_audioHandle);
-		_audioHandle = nullptr;
-	}
+	if (_mainloop != nullptr) {
+		pa_threaded_mainloop_stop(_mainloop);
+
+		if (_stream) {
+			pa_stream_disconnect(_stream);
+			pa_stream_unref(_stream);
+		}
+
+		if (_context) {
+			pa_context_disconnect(_context);
+			pa_context_unref(_context);
+		}
 
-	if (_sampleBuffer != nullptr) {
-		delete [] _sampleBuffer;
-		outOfOrder();
+		pa_threaded_mainloop_free(_mainloop);
 	}
+
+	delete [] _sampleBuffer;
+	outOfOrder();
+}
+
+// Drop what hasn't been played yet
+void Audio_Pulse::reset() {
+	if (_stream == nullptr)
+		return;
+
+	pa_threaded_mainloop_lock(_mainloop);
+	pa_operation *op = pa_stream_flush(_stream, nullptr, nullptr);
+	if (op)
+		pa_operation_unref(op);
+	pa_threaded_mainloop_unlock(_mainloop);
 }
 
 bool Audio_Pulse::write(uint_least32_t size) {
-	if (_audioHandle == nullptr) {
+	if (_stream == nullptr) {
 		setError("Device not open.");
 
 		return false;
 	}
 
-	int err;
-	if (pa_simple_write(_audioHandle, _sampleBuffer, size * 2, &err) < 0) {
-		setError(pa_strerror(err));
-		return false;
+	const stats_clock::time_point start = stats_clock::now();
+
+	const char *data  = (const char*) _sampleBuffer;
+	size_t		bytes = size * pa_sample_size(&_spec);
+
+	pa_threaded_mainloop_lock(_mainloop);
+
+	while (bytes) {
+		if (pa_stream_get_state(_stream) != PA_STREAM_READY) {
+			setError(lastError());
+			break;
+		}
+
+		// Wait for the server to ask for more
+		const size_t writable = pa_stream_writable_size(_stream);
+		if (writable == (size_t) -1) {
+			setError(lastError());
+			break;
+		}
+		if (writable == 0) {
+			pa_threaded_mainloop_wait(_mainloop);
+			continue;
+		}
+
+		const size_t chunk = std::min(writable, bytes);
+		if (pa_stream_write(_stream, data, chunk, nullptr, 0, PA_SEEK_RELATIVE) < 0) {
+			setError(lastError());
+			break;
+		}
+
+		data  += chunk;
+		bytes -= chunk;
 	}
 
-	return true;
+	countWrite(size, start);
+	pa_threaded_mainloop_unlock(_mainloop);
+
+	return bytes == 0;
+}
+
+AudioStats Audio_Pulse::stats() const {
+	if (_stream == nullptr)
+		return _stats;
+
+	pa_threaded_mainloop_lock(_mainloop);
+	AudioStats stats = _stats;
+
+	pa_usec_t latency;
+	int negative;
+	if ((pa_stream_get_latency(_stream, &latency, &negative) == 0) && !negative)
+		stats.delay = latency * _spec.rate / 1000000;
+	pa_threaded_mainloop_unlock(_mainloop);
+
+	return stats;
 }
@@ -30,25 +30,50 @@
 #  define AudioDriver Audio_Pulse
 #endif
 
-#include <pulse/simple.h>
+#include <pulse/pulseaudio.h>
 
 #include "../AudioBase.h"
 
+/*
+ * PulseAudio output.
+ *
+ * The stream runs on a threaded mainloop and write() waits for
+ * the server to ask for more, so the buffer can be sized: the
+ * configured buffer time becomes the target length (tlength),
+ * and the period the size of a request (minreq). The values the
+ * server settled on are put back in the configuration.
+ */
 class Audio_Pulse: public AudioBase {
 private:
-	pa_simple *_audioHandle;
+	pa_threaded_mainloop *_mainloop;
+	pa_context			 *_context;
+	pa_stream			 *_stream;
+	pa_sample_spec		  _spec;
 
 	void outOfOrder();
 
+	// Wait on the mainloop for the context or stream to settle
+	bool connect(const AudioConfig &cfg);
+
+	const char *lastError() const;
+
+	static void contextState(pa_context *context, void *userdata);
+	static void streamState(pa_stream *stream, void *userdata);
+	static void streamRequest(pa_stream *stream, size_t bytes, void *userdata);
+	static void streamUnderflow(pa_stream *stream, void *userdata);
+
 public:
 	Audio_Pulse();
 	~Audio_Pulse();
 
 	bool open (AudioConfig &cfg) override;
 	void close() override;
-	void reset() override {}
+	void reset() override;
 	bool write(uint_least32_t size) override;
 	void pause() override {}
+
+	// Adds the latency the server reports
+	AudioStats stats() const override;
 };
 
 #endif // AUDIO_PULSE_H
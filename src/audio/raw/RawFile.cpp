@@ -0,0 +1,196 @@
+/*
+ * This file is part of C64play, a console SID player.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "RawFile.h"
+
+#include <new>
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+// Frames per write, a bit less than 100 ms at 96 kHz
+constexpr unsigned int FRAMES = 8192;
+
+constexpr size_t PAGE_BYTES = 4096;
+
+// What the pipe is grown to, Linux allows this much by default
+constexpr int PIPE_SIZE = 1 << 20;
+
+}
+
+RawFile::RawFile(const std::string &name, bool splice) :
+	AudioBase("RAWFILE"),
+	name(name),
+	fd(-1),
+	buffers(nullptr),
+	count(0),
+	current(0),
+	bufBytes(0),
+	splice(splice),
+	splicing(false)
+{}
+
+bool RawFile::open(AudioConfig &cfg) {
+	if (name.empty())
+		return false;
+
+	if (fd >= 0)
+		close();
+
+	if (name.compare("-") == 0)
+		fd = STDOUT_FILENO;
+	else
+		fd = ::open(name.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+
+	if (fd < 0) {
+		setError("Unable to open the output file.");
+		return false;
+	}
+
+	cfg.depth	= 16;
+	cfg.bufSize = FRAMES * cfg.channels;
+
+	// Whole pages, so no page is shared between two buffers
+	bufBytes = ((cfg.bufSize * sizeof(short)) + PAGE_BYTES - 1) & ~(PAGE_BYTES - 1);
+	count	 = 1;
+	splicing = false;
+
+#if defined(HAVE_VMSPLICE) && defined(F_GETPIPE_SZ)
+	struct stat st;
+	if (splice && (fstat(fd, &st) == 0) && S_ISFIFO(st.st_mode)) {
+		// A bigger pipe means fewer wakeups for both ends,
+		// and it's fine if we don't get it
+		fcntl(fd, F_SETPIPE_SZ, PIPE_SIZE);
+
+		const int pipeSize = fcntl(fd, F_GETPIPE_SZ);
+		if (pipeSize > 0) {
+			// The pipe can't hold more than pipeSize bytes, so
+			// that much written after a buffer means it's been read
+			count	 = (pipeSize + bufBytes - 1) / bufBytes + 1;
+			splicing = true;
+		}
+	}
+#endif
+
+	try {
+		buffers = new short*[count]();
+		for (size_t i = 0; i < count; i++)
+			buffers[i] = static_cast<short*>(::operator new[](bufBytes, std::align_val_t(PAGE_BYTES)));
+	}
+	catch (std::bad_alloc const &ba) {
+		freeBuffers();
+		setError("Unable to allocate memory for sample buffers.");
+		return false;
+	}
+
+	current		  = 0;
+	_sampleBuffer = buffers[0];
+
+	_settings = cfg;
+	_stats	  = AudioStats();
+	return true;
+}
+
+bool RawFile::writeAll(const char *data, size_t bytes) {
+	while (bytes) {
+		const ssize_t written = ::write(fd, data, bytes);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		data  += written;
+		bytes -= written;
+	}
+
+	return true;
+}
+
+bool RawFile::write(uint_least32_t size) {
+	if (fd < 0)
+		return true;
+
+	const stats_clock::time_point start = stats_clock::now();
+
+	const char *data  = (const char*)_sampleBuffer;
+	size_t		bytes = size * sizeof(short);
+
+#ifdef HAVE_VMSPLICE
+	if (splicing) {
+		while (bytes) {
+			struct iovec iov = { (void*)data, bytes };
+
+			const ssize_t spliced = vmsplice(fd, &iov, 1, 0);
+			if (spliced < 0) {
+				if (errno == EINTR)
+					continue;
+
+				// Not supported after all, copy from now on
+				splicing = false;
+				break;
+			}
+
+			data  += spliced;
+			bytes -= spliced;
+		}
+
+		// The pipe still references this one
+		current		  = (current + 1) % count;
+		_sampleBuffer = buffers[current];
+	}
+#endif
+
+	if (!writeAll(data, bytes)) {
+		setError("Unable to write to the output file.");
+		return false;
+	}
+
+	countWrite(size, start);
+	return true;
+}
+
+void RawFile::freeBuffers() {
+	if (buffers) {
+		for (size_t i = 0; i < count; i++)
+			::operator delete[](buffers[i], std::align_val_t(PAGE_BYTES));
+		delete[] buffers;
+	}
+
+	buffers		  = nullptr;
+	_sampleBuffer = nullptr;
+}
+
+void RawFile::close() {
+	if (fd < 0)
+		return;
+
+	if (fd != STDOUT_FILENO)
+		::close(fd);
+	fd = -1;
+
+	freeBuffers();
+}
@@ -0,0 +1,72 @@
+/*
+ * This file is part of C64play, a console SID player.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef RAW_FILE_H
+#define RAW_FILE_H
+
+#include <stddef.h>
+
+#include <string>
+
+#include "../AudioBase.h"
+
+/*
+ * Headerless PCM output, signed 16-bit in host byte order,
+ * meant for feeding other programs through a pipe.
+ *
+ * Writes go straight to the file descriptor. When it's a pipe and
+ * splicing was asked for, the samples are handed over with
+ * vmsplice() instead of being copied, so the sample buffer rotates
+ * through a ring that's larger than the pipe: by the time a buffer
+ * comes around again, a reader that uses read() is done with its
+ * pages. One that splices or tees them on may not be, which is why
+ * it's not the default.
+ */
+class RawFile: public AudioBase {
+private:
+	std::string name;
+	int fd;
+
+	// Ring of page aligned buffers, just one if not splicing
+	short  **buffers;
+	size_t	 count;
+	size_t	 current;
+	size_t	 bufBytes;
+	bool	 splice;   // asked for
+	bool	 splicing; // and possible
+
+private:
+	void freeBuffers();
+	bool writeAll(const char *data, size_t bytes);
+
+public:
+	RawFile(const std::string &name, bool splice = false);
+	~RawFile() override { close(); }
+
+	static const char *extension() { return ".raw"; }
+
+	bool open(AudioConfig &cfg) override;
+	bool write(uint_least32_t size) override;
+	void close() override;
+	void pause() override {}
+	void reset() override {}
+};
+
+#endif /* RAW_FILE_H */
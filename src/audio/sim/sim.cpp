@@ -0,0 +1,179 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "sim.h"
+
+#include <algorithm>
+#include <new>
+#include <thread>
+
+namespace {
+
+// Same seed every time, so that runs can be compared
+constexpr unsigned int JITTER_SEED = 6581;
+
+uint_least32_t frames(uint_least32_t us, unsigned int rate) {
+	return (uint_least32_t) ((uint_least64_t) us * rate / 1000000);
+}
+
+}
+
+Audio_Sim::Audio_Sim(uint_least32_t jitter) :
+	AudioBase("SIM"),
+	jitter(jitter),
+	isOpen(false),
+	bufferFrames(0),
+	periodFrames(0),
+	fill(0),
+	running(false),
+	periods(0),
+	random(JITTER_SEED) {}
+
+Audio_Sim::~Audio_Sim() {
+	close();
+}
+
+bool Audio_Sim::open(AudioConfig &cfg) {
+	if (isOpen) {
+		setError("Audio device already open.");
+		return false;
+	}
+
+	// Laid out as ALSA would do it, but without limits of its own
+	if (cfg.lowLatency) {
+		periodFrames = frames(2500, cfg.sampleRate);
+		bufferFrames = periodFrames * 4;
+	} else {
+		bufferFrames = frames(cfg.bufferTime ? cfg.bufferTime : 200000, cfg.sampleRate);
+		periodFrames = cfg.periodTime ? frames(cfg.periodTime, cfg.sampleRate) : bufferFrames / 3;
+	}
+
+	// A period has to fit in the sample buffer
+	periodFrames = std::clamp<uint_least32_t>(periodFrames, 1, 0xffff / cfg.channels);
+	bufferFrames = std::max(bufferFrames, periodFrames * 2);
+
+	periodLength = std::chrono::duration_cast<stats_clock::duration>(
+		std::chrono::duration<double>((double) periodFrames / cfg.sampleRate));
+
+	cfg.depth	   = 16;
+	cfg.bufSize	   = periodFrames * cfg.channels;
+	cfg.bufferTime = (uint_least64_t) bufferFrames * 1000000 / cfg.sampleRate;
+	cfg.periodTime = (uint_least64_t) periodFrames * 1000000 / cfg.sampleRate;
+
+	try {
+		_sampleBuffer = new short[cfg.bufSize];
+	}
+	catch (std::bad_alloc const &ba) {
+		setError("Unable to allocate memory for sample buffers.");
+		return false;
+	}
+
+	fill	= 0;
+	running = false;
+	random.seed(JITTER_SEED);
+
+	isOpen	  = true;
+	_settings = cfg;
+	_stats	  = AudioStats();
+	return true;
+}
+
+void Audio_Sim::start(stats_clock::time_point now) {
+	running = true;
+	started = now;
+	periods = 0;
+	nextPeriod();
+}
+
+// On time plus however late this one is, so the lateness
+// doesn't add up from one period to the next
+void Audio_Sim::nextPeriod() {
+	const uint_least32_t late = jitter ?
+		std::uniform_int_distribution<uint_least32_t>(0, jitter)(random) : 0;
+
+	deadline = started + periodLength * (periods + 1) + std::chrono::microseconds(late);
+}
+
+void Audio_Sim::advance(stats_clock::time_point now) {
+	while (running && (now >= deadline)) {
+		if (fill < periodFrames) {
+			// Ran dry, what's left was played with a gap after it
+			fill	= 0;
+			running = false;
+			_stats.underruns++;
+			break;
+		}
+
+		fill -= periodFrames;
+		periods++;
+		nextPeriod();
+	}
+}
+
+bool Audio_Sim::write(uint_least32_t size) {
+	if (!isOpen) {
+		setError("Audio device not open.");
+		return false;
+	}
+
+	const stats_clock::time_point begin = stats_clock::now();
+	const uint_least32_t count = std::min(size / _settings.channels, bufferFrames);
+
+	for (;;) {
+		const stats_clock::time_point now = stats_clock::now();
+		advance(now);
+
+		if (bufferFrames - fill >= count)
+			break;
+
+		// Full, so play it if it isn't already, and wait for room
+		if (!running)
+			start(now);
+		else
+			std::this_thread::sleep_until(deadline);
+	}
+
+	fill += count;
+	if (!running && (fill >= bufferFrames))
+		start(stats_clock::now());
+
+	countWrite(size, begin);
+	return true;
+}
+
+void Audio_Sim::reset() {
+	fill	= 0;
+	running = false;
+}
+
+void Audio_Sim::close() {
+	if (!isOpen)
+		return;
+
+	delete[] _sampleBuffer;
+	_sampleBuffer = nullptr;
+	isOpen = false;
+}
+
+AudioStats Audio_Sim::stats() const {
+	AudioStats stats = _stats;
+	stats.delay = fill;
+	return stats;
+}
@@ -0,0 +1,83 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef AUDIO_SIM_H
+#define AUDIO_SIM_H
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <random>
+
+#include "../AudioBase.h"
+
+/*
+ * Simulated sound card, for trying out realtime behaviour on
+ * machines without one.
+ *
+ * Samples go into a ring sized like ALSA's from the configured
+ * buffer and period times, and are played a period at a time
+ * against the monotonic clock. Each period may end up to the
+ * given jitter late, the way interrupts do on a loaded machine,
+ * though the rate stays right on average. write() blocks while
+ * the ring is full, and a period that finds it short of samples
+ * is an underrun: the ring is then refilled before it restarts.
+ */
+class Audio_Sim: public AudioBase {
+private:
+	const uint_least32_t jitter; // microseconds
+	bool isOpen;
+
+	uint_least32_t bufferFrames;
+	uint_least32_t periodFrames;
+	stats_clock::duration periodLength;
+
+	uint_least32_t fill; // frames not played yet
+	bool running;
+
+	stats_clock::time_point started;
+	uint_least64_t periods;		  // played since then
+	stats_clock::time_point deadline; // end of the one playing
+
+	std::minstd_rand random;
+
+private:
+	void start(stats_clock::time_point now);
+	void nextPeriod();
+
+	// Play the periods that are over by now
+	void advance(stats_clock::time_point now);
+
+public:
+	Audio_Sim(uint_least32_t jitter = 0);
+	~Audio_Sim() override;
+
+	bool open (AudioConfig &cfg) override;
+	void close() override;
+	void reset() override;
+	bool write(uint_least32_t size) override;
+	void pause() override {}
+
+	// Adds what's queued as the delay
+	AudioStats stats() const override;
+};
+
+#endif // AUDIO_SIM_H
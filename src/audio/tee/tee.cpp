@@ -0,0 +1,220 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "tee.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace {
+
+// How far the recorder may fall behind before playback waits
+constexpr unsigned int RING_SECONDS = 2;
+
+constexpr unsigned int MIN_SLOTS = 4;
+
+}
+
+Audio_Tee::Audio_Tee(IAudio *device, IAudio *record) :
+	AudioBase("TEE"),
+	device(device),
+	record(record),
+	failing(nullptr),
+	isOpen(false),
+	recordSize(0),
+	slotSize(0),
+	slots(0),
+	m_head(0),
+	m_tail(0),
+	m_count(0),
+	m_stop(false),
+	m_failed(false) {}
+
+Audio_Tee::~Audio_Tee() {
+	close();
+
+	delete record;
+	delete device;
+}
+
+bool Audio_Tee::open(AudioConfig &cfg) {
+	if (isOpen) {
+		setError("Audio device already open.");
+		return false;
+	}
+
+	failing = nullptr;
+	clearError();
+
+	AudioConfig deviceCfg = cfg;
+	deviceCfg.depth = 16;
+
+	if (!device->open(deviceCfg)) {
+		failing = device;
+		return false;
+	}
+
+	if (deviceCfg.depth != 16) {
+		device->close();
+		setError("Sound card doesn't take 16-bit samples.");
+		return false;
+	}
+
+	// Whatever rate the device settled on, and 24 bits would
+	// need samples of another size
+	AudioConfig recordCfg = deviceCfg;
+	recordCfg.depth	  = (cfg.depth == 24) ? 16 : cfg.depth;
+	recordCfg.bufSize = 0;
+
+	if (!record->open(recordCfg)) {
+		device->close();
+		failing = record;
+		return false;
+	}
+
+	recordSize = recordCfg.bufSize - (recordCfg.bufSize % deviceCfg.channels);
+	slotSize   = deviceCfg.bufSize;
+	slots	   = std::max<unsigned int>(MIN_SLOTS,
+		(RING_SECONDS * deviceCfg.sampleRate * deviceCfg.channels + slotSize - 1) / slotSize);
+
+	try {
+		ring.assign(slotSize * slots, 0);
+		sizes.assign(slots, 0);
+	}
+	catch (std::bad_alloc const &ba) {
+		record->close();
+		device->close();
+		setError("Unable to allocate memory for sample buffers.");
+		return false;
+	}
+
+	m_head	 = 0;
+	m_tail	 = 0;
+	m_count	 = 0;
+	m_stop	 = false;
+	m_failed = false;
+
+	m_thread = std::thread(&Audio_Tee::run, this);
+
+	cfg		  = deviceCfg;
+	cfg.depth = recordCfg.depth;
+
+	_settings = cfg;
+	isOpen	  = true;
+	return true;
+}
+
+bool Audio_Tee::write(uint_least32_t size) {
+	if (!isOpen)
+		return true;
+
+	if (m_failed) {
+		failing = record;
+		return false;
+	}
+
+	size = std::min<uint_least32_t>(size, slotSize);
+
+	{	// Only when the recorder has been stuck for a while
+		std::unique_lock<std::mutex> lock(m_lock);
+		m_written.wait(lock, [this] { return m_count < slots; });
+	}
+
+	// The thread doesn't touch the slot until it's queued
+	std::memcpy(&ring[m_tail * slotSize], device->buffer(), size * sizeof(short));
+	sizes[m_tail] = size;
+
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_tail = (m_tail + 1) % slots;
+		m_count++;
+	}
+	m_queued.notify_one();
+
+	if (!device->write(size)) {
+		failing = device;
+		return false;
+	}
+
+	return true;
+}
+
+void Audio_Tee::run() {
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	for (;;) {
+		m_queued.wait(lock, [this] { return m_count || m_stop; });
+		if (!m_count)
+			break;
+
+		// The slot is ours until the count drops
+		const short   *data = &ring[m_head * slotSize];
+		uint_least32_t size = sizes[m_head];
+		lock.unlock();
+
+		// The recorder may take less at once than the device
+		while (size && !m_failed) {
+			const uint_least32_t chunk = std::min(size, recordSize);
+			std::memcpy(record->buffer(), data, chunk * sizeof(short));
+
+			if (!record->write(chunk))
+				m_failed = true;
+
+			data += chunk;
+			size -= chunk;
+		}
+
+		lock.lock();
+		m_head = (m_head + 1) % slots;
+		m_count--;
+		m_written.notify_one();
+	}
+}
+
+void Audio_Tee::finish() {
+	if (!m_thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_stop = true;
+	}
+	m_queued.notify_one();
+	m_thread.join();
+}
+
+void Audio_Tee::close() {
+	if (!isOpen)
+		return;
+
+	finish();
+
+	record->close();
+	device->close();
+
+	ring.clear();
+	ring.shrink_to_fit();
+	isOpen = false;
+}
+
+const char *Audio_Tee::getErrorString() const {
+	return failing ? failing->getErrorString() : AudioBase::getErrorString();
+}
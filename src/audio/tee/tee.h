@@ -0,0 +1,105 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef AUDIO_TEE_H
+#define AUDIO_TEE_H
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../AudioBase.h"
+
+/*
+ * Plays on one output while recording to another, so that a
+ * capture can be listened to without running the emulation twice.
+ *
+ * The player fills the device's buffer as usual. On write() a
+ * copy goes into a ring for a thread of our own, which feeds it
+ * to the recorder, and the device is then written as it would
+ * be on its own: a slow disk or encoder only holds up playback
+ * once the ring, a couple of seconds deep, has filled up.
+ *
+ * Both take signed 16-bit samples, the recorder's depth is only
+ * how it stores them. Polling and statistics are the device's.
+ */
+class Audio_Tee: public AudioBase {
+private:
+	IAudio *const device;
+	IAudio *const record;
+	const IAudio *failing; // whose error to report
+
+	bool isOpen;
+	uint_least32_t recordSize; // samples the recorder takes at once
+
+	// Ring of buffers queued for the recorder
+	std::vector<short> ring;
+	std::vector<uint_least32_t> sizes;
+	size_t		 slotSize; // samples
+	unsigned int slots;
+
+	unsigned int m_head;  // next buffer to record
+	unsigned int m_tail;  // next buffer to fill
+	unsigned int m_count; // buffers queued
+
+	bool			  m_stop;
+	std::atomic<bool> m_failed;
+
+	std::mutex				m_lock;
+	std::condition_variable m_queued;
+	std::condition_variable m_written;
+	std::thread				m_thread;
+
+private:
+	void run();
+
+	// Record whatever is queued and stop the thread
+	void finish();
+
+public:
+	// Takes ownership of both
+	Audio_Tee(IAudio *device, IAudio *record);
+	~Audio_Tee() override;
+
+	bool open (AudioConfig &cfg) override;
+	void close() override;
+	void reset() override { device->reset(); }
+	bool write(uint_least32_t size) override;
+	void pause() override { device->pause(); }
+
+	short *buffer() const override { return device->buffer(); }
+	const char *getErrorString() const override;
+
+	AudioStats stats() const override { return device->stats(); }
+	int pollDescriptors(struct pollfd *fds, int space) const override { return device->pollDescriptors(fds, space); }
+	bool ready(struct pollfd *fds, int count) override { return device->ready(fds, count); }
+
+	IAudio *recorder() const { return record; }
+};
+
+#endif // AUDIO_TEE_H
@@ -24,13 +24,27 @@
 
 #include "WavFile.h"
 
-#include <vector>
+#include <algorithm>
 #include <iomanip>
 #include <fstream>
 #include <new>
 
+#include <cstdio>
 #include <cstring>
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#  include <tmmintrin.h>
+#endif
+
+#ifdef WAV_MMAP
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
 // Get the lo byte (8 bit) in a dword (32 bit)
 inline uint8_t endian_32lo8(uint_least32_t dword) {
 	return (uint8_t) dword;
@@ -72,6 +86,66 @@ inline void endian_little32(uint8_t ptr[4], uint_least32_t dword) {
 	ptr[3] = endian_16hi8 (word);
 }
 
+// Write a little-endian 64-bit word to eight bytes in memory.
+inline void endian_little64(uint8_t ptr[8], uint_least64_t qword) {
+	endian_little32(ptr, (uint_least32_t) qword);
+	endian_little32(ptr + 4, (uint_least32_t) (qword >> 32));
+}
+
+// Swap the bytes of a 32-bit word
+inline uint_least32_t endian_swap32(uint_least32_t dword) {
+	return ((dword & 0x000000ff) << 24) | ((dword & 0x0000ff00) << 8)
+		 | ((dword & 0x00ff0000) >> 8)	| ((dword & 0xff000000) >> 24);
+}
+
+// Normalize signed 16-bit samples into floats, eight at a
+// time where SSE2 is around
+static void convertSamples(const short *in, float *out, unsigned long size) {
+	unsigned long i = 0;
+
+#ifdef __SSE2__
+	const __m128 scale = _mm_set1_ps(1.f/32768.f);
+
+	for (; i + 8 <= size; i += 8) {
+		const __m128i samples = _mm_loadu_si128((const __m128i*)(in + i));
+
+		// Sign extend by moving each word to the top of a dword
+		const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+		const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+
+		_mm_storeu_ps(out + i,	   _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+#endif
+
+	for (; i < size; i++)
+		out[i] = ((float)in[i])/32768.f;
+}
+
+// Pack 24-bit samples held in 32-bit words into three little
+// endian bytes each. With SSSE3 four samples are shuffled at a
+// time, each store overlapping the next by four bytes.
+static void pack24(const int_least32_t *in, uint8_t *out, unsigned long size) {
+	unsigned long i = 0;
+
+#if defined(__SSSE3__) && !defined(WORDS_BIGENDIAN)
+	const __m128i shuffle = _mm_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+
+	// Stop while a whole 16-byte store still fits
+	for (; i + 6 <= size; i += 4) {
+		const __m128i samples = _mm_loadu_si128((const __m128i*)(in + i));
+		_mm_storeu_si128((__m128i*)(out + i*3), _mm_shuffle_epi8(samples, shuffle));
+	}
+#endif
+
+	for (; i < size; i++) {
+		const uint_least32_t sample = (uint_least32_t)in[i];
+		out[i*3]	 = (uint8_t)sample;
+		out[i*3 + 1] = (uint8_t)(sample >> 8);
+		out[i*3 + 2] = (uint8_t)(sample >> 16);
+	}
+}
+
 const riffHeader WavFile::defaultRiffHdr = {
 	// ASCII keywords are hexified.
 	{0x52,0x49,0x46,0x46}, // 'RIFF'
@@ -79,6 +153,15 @@ const riffHeader WavFile::defaultRiffHdr = {
 	{0x57,0x41,0x56,0x45}, // 'WAVE'
 };
 
+const ds64Chunk WavFile::defaultDs64 = {
+	{0x4A,0x55,0x4E,0x4B}, // 'JUNK'
+	{28,0,0,0},			   // length
+	{0,0,0,0,0,0,0,0},	   // RIFF length
+	{0,0,0,0,0,0,0,0},	   // data length
+	{0,0,0,0,0,0,0,0},	   // frames
+	{0,0,0,0}			   // table length
+};
+
 const wavHeader WavFile::defaultWavHdr = {
 	{0x66,0x6d,0x74,0x20}, // 'fmt '
 	{16,0,0,0},			   // length
@@ -108,15 +191,32 @@ const listInfo WavFile::defaultListInfo = {
 	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}
 };
 
+const listComment WavFile::defaultListComment = {
+	{0x49,0x43,0x4D,0x54}, // 'ICMT'
+	{64,0,0,0},			   // length
+	{0}
+};
+
 WavFile::WavFile(const std::string &name) :
 	AudioBase("WAVFILE"),
 	name(name),
 	riffHdr(defaultRiffHdr),
 	wavHdr(defaultWavHdr),
+	ds64(defaultDs64),
 	listHdr(defaultListInfo),
+	listCmt(defaultListComment),
+	convBuffer(nullptr),
 	file(nullptr),
+#ifdef WAV_MMAP
+	fd(-1),
+	map(nullptr),
+	mapSize(0),
+	mapPos(0),
+	heapBuffer(nullptr),
+#endif
 	headerWritten(false),
 	hasListInfo(false),
+	hasComment(false),
 	depth(32)
 {}
 
@@ -124,24 +224,34 @@ bool WavFile::open(AudioConfig &cfg) {
 	depth = cfg.depth;
 
 	unsigned short bits		  = depth;
-	unsigned short format	  = (depth == 16) ? 1 : 3;
+	unsigned short format	  = (depth == 32) ? 3 : 1;
 	unsigned short channels   = cfg.channels;
 	unsigned long  freq		  = cfg.sampleRate;
 	unsigned short blockAlign = (bits>>3)*channels;
 	unsigned long  bufSize	  = freq * blockAlign;
 	cfg.bufSize = bufSize;
 
+	// The player asks for up to cfg.bufSize samples, which
+	// is more than a second's worth when it isn't truncated
+	const unsigned long samples = std::max<unsigned long>(freq * channels, cfg.bufSize);
+	bufBytes = samples * (bits>>3);
+
 	if (name.empty())
 		return false;
 
-	if (file && !file->fail())
+	if ((file && !file->fail()) || isMapped())
 		close();
 
 	dataSize = 0;
+	headerWritten = false;
 
-	// We need to make a buffer for the user
+	// We need to make a buffer for the user, plus one to convert
+	// samples into for float output, or to pack 24-bit ones into.
+	// 24-bit samples come in 32-bit words.
 	try {
-		_sampleBuffer = new short[bufSize/2];
+		_sampleBuffer = new short[(depth == 24) ? samples * 2 : samples];
+		if (depth != 16)
+			convBuffer = new float[samples];
 	}
 	catch (std::bad_alloc const &ba) {
 		setError("Unable to allocate memory for sample buffers.");
@@ -149,7 +259,9 @@ bool WavFile::open(AudioConfig &cfg) {
 	}
 
 	// Fill in header with parameters and expected file size.
-	endian_little32(riffHdr.length, sizeof(riffHeader)+sizeof(wavHeader)-8);
+	riffHdr = defaultRiffHdr;
+	ds64	= defaultDs64;
+	endian_little32(riffHdr.length, sizeof(riffHeader)+sizeof(ds64Chunk)+sizeof(wavHeader)-8);
 	endian_little16(wavHdr.channels, channels);
 	endian_little16(wavHdr.format, format);
 	endian_little32(wavHdr.sampleFreq, freq);
@@ -159,65 +271,277 @@ bool WavFile::open(AudioConfig &cfg) {
 	endian_little32(wavHdr.dataChunkLen, 0);
 
 	if (name.compare("-") == 0) {
+		// There's no going back to fix the lengths on a pipe
 		file = &std::cout;
+		endian_little32(riffHdr.length, 0xffffffff);
+		endian_little32(wavHdr.dataChunkLen, 0xffffffff);
 	} else {
 		file = new std::ofstream(name.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
 	}
 
+	// Disk stalls are left to the writer's thread
+	if (!writer.start(file)) {
+		setError("Unable to allocate memory for write buffers.");
+		return false;
+	}
+
 	_settings = cfg;
+	_stats	  = AudioStats();
+	return true;
+}
+
+// Header size up to the samples, with the chunks in use
+size_t WavFile::headerSize() const {
+	size_t size = sizeof(riffHeader)+sizeof(ds64Chunk)+sizeof(wavHeader);
+	if (hasListInfo)
+		size += sizeof(listInfo);
+	if (hasComment)
+		size += sizeof(listComment);
+
+	return size;
+}
+
+// Fill in the lengths now that they're known
+void WavFile::updateHeader() {
+	const uint_least64_t riffSize = headerSize()-8+dataSize;
+
+	if (riffSize > 0xffffffff) {
+		// Too big for RIFF, the real lengths go in ds64
+		static const char rf64[4] = {0x52,0x46,0x36,0x34}; // 'RF64'
+		static const char ds64Id[4] = {0x64,0x73,0x36,0x34}; // 'ds64'
+
+		std::memcpy(riffHdr.mainChunkID, rf64, 4);
+		std::memcpy(ds64.chunkID, ds64Id, 4);
+		endian_little64(ds64.riffSize, riffSize);
+		endian_little64(ds64.dataSize, dataSize);
+		endian_little64(ds64.sampleCount, dataSize / ((depth>>3) * _settings.channels));
+		endian_little32(riffHdr.length, 0xffffffff);
+		endian_little32(wavHdr.dataChunkLen, 0xffffffff);
+	} else {
+		endian_little32(riffHdr.length, riffSize);
+		endian_little32(wavHdr.dataChunkLen, dataSize);
+	}
+}
+
+// Copy the header into memory, returns where it ends
+char *WavFile::copyHeader(char *out) const {
+	std::memcpy(out, &riffHdr, sizeof(riffHeader));
+	out += sizeof(riffHeader);
+	std::memcpy(out, &ds64, sizeof(ds64Chunk));
+	out += sizeof(ds64Chunk);
+	if (hasListInfo) {
+		std::memcpy(out, &listHdr, sizeof(listInfo));
+		out += sizeof(listInfo);
+	}
+	if (hasComment) {
+		std::memcpy(out, &listCmt, sizeof(listComment));
+		out += sizeof(listComment);
+	}
+	std::memcpy(out, &wavHdr, sizeof(wavHeader));
+	return out + sizeof(wavHeader);
+}
+
+#ifdef WAV_MMAP
+void WavFile::setLength(uint_least32_t ms) {
+	if (!file || (file == &std::cout) || headerWritten || (fd >= 0) || !ms)
+		return;
+
+	const uint_least64_t bytes = (uint_least64_t)ms * _settings.sampleRate / 1000
+		* ((depth>>3) * _settings.channels);
+
+	// The stream has nothing in it yet, so trade it for
+	// a descriptor on the same file
+	writer.stop();
+
+	fd = ::open(name.c_str(), O_RDWR);
+	if (fd < 0)
+		return;
+
+	if (!mapFile(headerSize() + bytes + bufBytes)) {
+		::close(fd);
+		fd = -1;
+		writer.start(file);
+		return;
+	}
+
+	delete file;
+	file = nullptr;
+
+	mapPos = copyHeader(map) - map;
+	headerWritten = true;
+
+	// 16-bit samples get mixed right into the file
+	heapBuffer = _sampleBuffer;
+#ifndef WORDS_BIGENDIAN
+	if (depth == 16)
+		_sampleBuffer = (short*)(map + mapPos);
+#endif
+}
+
+bool WavFile::mapFile(size_t size) {
+	if (map) {
+		munmap(map, mapSize);
+		map = nullptr;
+	}
+
+	// Reserve the blocks up front so the file isn't fragmented,
+	// and so writing to the map can't run out of disk space
+	if (posix_fallocate(fd, 0, size) != 0)
+		return false;
+
+	void *addr = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED)
+		return false;
+
+	map		= (char*)addr;
+	mapSize = size;
 	return true;
 }
 
+bool WavFile::writeMapped(uint_least32_t size) {
+	const unsigned long bytes = size * (depth>>3);
+
+	if (depth == 16) {
+#ifdef WORDS_BIGENDIAN
+		const uint_least16_t *in = (const uint_least16_t*)_sampleBuffer;
+		uint_least16_t *words = (uint_least16_t*)(map + mapPos);
+		for (unsigned long i=0; i<size; i++)
+			words[i] = (uint_least16_t)((in[i] << 8) | (in[i] >> 8));
+#endif
+	} else if (depth == 24) {
+		pack24((const int_least32_t*)_sampleBuffer, (uint8_t*)(map + mapPos), size);
+	} else {
+		float *out = (float*)(map + mapPos);
+		convertSamples(_sampleBuffer, out, size);
+#ifdef WORDS_BIGENDIAN
+		uint32_t *dwords = (uint32_t*)out;
+		for (unsigned long i=0; i<size; i++)
+			dwords[i] = endian_swap32(dwords[i]);
+#endif
+	}
+
+	mapPos	 += bytes;
+	dataSize += bytes;
+
+	// Ran past the expected length, keep room for a whole buffer
+	if (mapPos + bufBytes > mapSize) {
+		if (!mapFile(std::max(mapSize * 2, mapPos + bufBytes))) {
+			setError("Unable to grow the output file.");
+			return false;
+		}
+	}
+
+#ifndef WORDS_BIGENDIAN
+	if (depth == 16)
+		_sampleBuffer = (short*)(map + mapPos);
+#endif
+
+	return true;
+}
+#endif
+
 bool WavFile::write(uint_least32_t size) {
-	if (file && !file->fail()) {
+	// Time spent here is mostly waiting for the disk
+	const stats_clock::time_point start = stats_clock::now();
+
+#ifdef WAV_MMAP
+	if (map) {
+		const bool ok = writeMapped(size);
+		countWrite(size, start);
+		return ok;
+	}
+#endif
+
+	if (file && !writer.failed()) {
 		unsigned long int bytes = size;
 		if (!headerWritten) {
-			file->write((char*)&riffHdr, sizeof(riffHeader));
+			writer.write(&riffHdr, sizeof(riffHeader));
+			if (file != &std::cout)
+				writer.write(&ds64, sizeof(ds64Chunk));
 			if (hasListInfo)
-				file->write((char*)&listHdr, sizeof(listInfo));
-			file->write((char*)&wavHdr, sizeof(wavHeader));
+				writer.write(&listHdr, sizeof(listInfo));
+			if (hasComment)
+				writer.write(&listCmt, sizeof(listComment));
+			writer.write(&wavHdr, sizeof(wavHeader));
 			headerWritten = true;
 		}
 
-		/* XXX endianness... */
+		// Samples are swapped in place on big endian hosts,
+		// the buffer gets overwritten by the next call anyway
 		if (depth == 16) {
 			bytes *= 2;
-			file->write((char*)_sampleBuffer, bytes);
+#ifdef WORDS_BIGENDIAN
+			uint_least16_t *words = (uint_least16_t*)_sampleBuffer;
+			for (unsigned long i=0; i<size; i++)
+				words[i] = (uint_least16_t)((words[i] << 8) | (words[i] >> 8));
+#endif
+			writer.write(_sampleBuffer, bytes);
+		} else if (depth == 24) {
+			bytes *= 3;
+			pack24((const int_least32_t*)_sampleBuffer, (uint8_t*)convBuffer, size);
+			writer.write(convBuffer, bytes);
 		} else {
-			std::vector<float> buffer(size);
 			bytes *= 4;
-			// normalize floats
-			for (unsigned long i=0; i<size; i++) {
-				buffer[i] = ((float)_sampleBuffer[i])/32768.f;
-			}
-			file->write((char*)&buffer.front(), bytes);
+			convertSamples(_sampleBuffer, convBuffer, size);
+#ifdef WORDS_BIGENDIAN
+			uint32_t *dwords = (uint32_t*)convBuffer;
+			for (unsigned long i=0; i<size; i++)
+				dwords[i] = endian_swap32(dwords[i]);
+#endif
+			writer.write(convBuffer, bytes);
 		}
 		dataSize += bytes;
 	}
 
+	countWrite(size, start);
 	return true;
 }
 
 void WavFile::close() {
-	if (file && !file->fail()) {
-		// update length fields in header
-		unsigned long int headerSize = sizeof(riffHeader)+sizeof(wavHeader)-8;
-		if (hasListInfo)
-			headerSize += sizeof(listInfo);
+#ifdef WAV_MMAP
+	if (fd >= 0) {
+		// The header is right there, then cut off what
+		// was reserved but not used
+		if (map) {
+			updateHeader();
+			copyHeader(map);
+			munmap(map, mapSize);
+			map = nullptr;
+		}
 
-		endian_little32(riffHdr.length, headerSize+dataSize);
-		endian_little32(wavHdr.dataChunkLen, dataSize);
+		if (ftruncate(fd, headerSize() + dataSize) != 0)
+			setError("Unable to truncate the output file.");
+		::close(fd);
+		fd = -1;
+
+		delete[] heapBuffer;
+		heapBuffer	  = nullptr;
+		_sampleBuffer = nullptr;
+		delete[] convBuffer;
+		convBuffer = nullptr;
+		return;
+	}
+#endif
+
+	// Let the queued data reach the file first
+	writer.stop();
+
+	if (file && !file->fail()) {
 		if (file != &std::cout) {
+			updateHeader();
+
+			char header[sizeof(riffHeader)+sizeof(ds64Chunk)+sizeof(listInfo)
+						+sizeof(listComment)+sizeof(wavHeader)];
+
 			file->seekp(0, std::ios::beg);
-			file->write((char*)&riffHdr, sizeof(riffHeader));
-			if (hasListInfo)
-				file->write((char*)&listHdr, sizeof(listInfo));
-			file->write((char*)&wavHdr, sizeof(wavHeader));
+			file->write(header, copyHeader(header) - header);
 			delete file;
 		}
 
 		file = nullptr;
 		delete[] _sampleBuffer;
+		delete[] convBuffer;
+		convBuffer = nullptr;
 	}
 }
 
@@ -227,3 +551,15 @@ void WavFile::setInfo(const char* title, const char* author, const char* release
 	std::memcpy(listHdr.artist, author, 32);
 	std::memcpy(listHdr.released, released, 32);
 }
+
+void WavFile::setReplayGain(double gain, double peak) {
+	hasListInfo = true;
+	hasComment	= true;
+
+	std::snprintf(listCmt.comment, sizeof(listCmt.comment),
+				  "REPLAYGAIN_TRACK_GAIN=%+.2f dB REPLAYGAIN_TRACK_PEAK=%.6f",
+				  gain, peak);
+
+	// The comment goes inside the list
+	endian_little32(listHdr.length, 124 + sizeof(listComment));
+}
@@ -28,7 +28,10 @@
 #include <iostream>
 #include <string>
 
+#include <stddef.h>
+
 #include "../AudioBase.h"
+#include "../AsyncWriter.h"
 
 struct riffHeader {						// little endian format
 	char mainChunkID[4];				// 'RIFF' (ASCII)
@@ -36,6 +39,15 @@ struct riffHeader {						// little endian format
 	char chunkID[4];					// 'WAVE' (ASCII)
 };
 
+struct ds64Chunk {						// little endian format
+	char chunkID[4];					// 'ds64', or 'JUNK' while not needed
+	unsigned char chunkLen[4];			// length of chunk, always 28 bytes
+	unsigned char riffSize[8];			// 64-bit RIFF length
+	unsigned char dataSize[8];			// 64-bit data length
+	unsigned char sampleCount[8];		// frames in the data chunk
+	unsigned char tableLength[4];		// no other chunks are too big
+};
+
 struct wavHeader {						// little endian format
 	char subChunkID[4];					// 'fmt ' (ASCII)
 	char subChunkLen[4];				// length of subChunk, always 16 bytes
@@ -71,6 +83,17 @@ struct listInfo {						// little endian format
 	char released[32];
 };
 
+struct listComment {					// little endian format
+	char cmtChunkID[4];					// 'ICMT' (ASCII)
+	char cmtChunkLen[4];				// length of subChunk, always 64 bytes
+	char comment[64];
+};
+
+// Files of known length are written through a memory map
+#if defined(HAVE_MMAP) && defined(HAVE_POSIX_FALLOCATE)
+#  define WAV_MMAP
+#endif
+
 /*
  * A basic WAV output file type
  * Initial implementation by Michael Schwendt <mschwendt@yahoo.com>
@@ -79,7 +102,7 @@ class WavFile: public AudioBase {
 private:
 	std::string name;
 
-	unsigned long int dataSize;
+	uint_least64_t dataSize;
 
 	static const riffHeader defaultRiffHdr;
 	riffHeader riffHdr;
@@ -87,25 +110,68 @@ private:
 	static const wavHeader defaultWavHdr;
 	wavHeader wavHdr;
 
+	// Reserves room for switching to RF64
+	// if the file goes past 4 GiB
+	static const ds64Chunk defaultDs64;
+	ds64Chunk ds64;
+
 	static const listInfo defaultListInfo;
 	listInfo listHdr;
 
+	static const listComment defaultListComment;
+	listComment listCmt;
+
+	// Samples converted for float output, or packed for 24-bit
+	float *convBuffer;
+
 	std::ostream *file;
+	AsyncWriter	  writer; // all writes go through it until close
+
+	// Largest write, in bytes of the file
+	unsigned long bufBytes;
+
+#ifdef WAV_MMAP
+	int			  fd;
+	char		 *map;
+	size_t		  mapSize;
+	size_t		  mapPos;	  // where the next samples go
+	short		 *heapBuffer; // ours while mixing into the map
+#endif
 	bool headerWritten;
 	bool hasListInfo;
+	bool hasComment;
 	int  depth;
 
+private:
+	size_t headerSize() const;
+	void   updateHeader();
+	char  *copyHeader(char *out) const;
+
+#ifdef WAV_MMAP
+	bool mapFile(size_t size);
+	bool writeMapped(uint_least32_t size);
+	bool isMapped() const { return fd >= 0; }
+#else
+	bool isMapped() const { return false; }
+#endif
+
 public:
 	WavFile(const std::string &name);
 	~WavFile() override { close(); }
 
 	static const char *extension() { return ".wav"; }
 
-	// Only signed 16-bit and 32bit float samples are supported.
-	// Endian-ess is adjusted if necessary.
+	// Signed 16-bit, signed 24-bit and 32bit float samples are
+	// supported. For 24-bit the sample buffer holds one 32-bit
+	// word per sample. Endian-ess is adjusted if necessary on
+	// big endian hosts.
 	//
 	// If number of sample bytes is given, this can speed up the
 	// process of closing a huge file on slow storage media.
+	//
+	// Files too big for RIFF become RF64 (EBU Tech 3306) when
+	// closed. On stdout the lengths are left as 0xFFFFFFFF,
+	// which readers take as "until the end of the stream".
 
 	bool open(AudioConfig &cfg) override;
 
@@ -121,6 +187,18 @@ public:
 	bool bad () const { return (file->bad()  != 0); }
 
 	void setInfo(const char* title, const char* author, const char* released);
+
+	// Adds ReplayGain values as a comment to the INFO list
+	void setReplayGain(double gain, double peak);
+
+	// Length of the render, if known before the first write.
+	// The file is then preallocated and written through a
+	// memory map, with the header filled in place when closed.
+#ifdef WAV_MMAP
+	void setLength(uint_least32_t ms);
+#else
+	void setLength(uint_least32_t) {}
+#endif
 };
 
 #endif /* WAV_FILE_H */
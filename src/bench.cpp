@@ -0,0 +1,92 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "player.h"
+
+#include <iostream>
+#include <iomanip>
+
+#include <sidplayfp/sidbuilder.h>
+
+using std::cout;
+using std::endl;
+
+// 64-bit FNV-1a parameters
+constexpr uint_least64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+constexpr uint_least64_t FNV_PRIME	= 0x100000001b3ULL;
+
+static double toMs(bench_clock::duration d) {
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void ConsolePlayer::benchReset() {
+	m_bench.cycles	  = 0;
+	m_bench.samples   = 0;
+	m_bench.hash	  = FNV_OFFSET;
+	m_bench.emulation = bench_clock::duration::zero();
+	m_bench.mixing	  = bench_clock::duration::zero();
+	m_bench.output	  = bench_clock::duration::zero();
+	m_bench.started   = bench_clock::now();
+}
+
+// Samples are fed as little-endian bytes so that the
+// fingerprint of a render doesn't depend on the host
+void ConsolePlayer::benchHash(const short *buffer, uint_least32_t size) {
+	uint_least64_t hash = m_bench.hash;
+
+	for (uint_least32_t i = 0; i < size; ++i) {
+		const uint_least16_t sample = static_cast<uint_least16_t>(buffer[i]);
+
+		hash = (hash ^ (sample & 0xff)) * FNV_PRIME;
+		hash = (hash ^ (sample >> 8)) * FNV_PRIME;
+	}
+
+	m_bench.hash = hash;
+}
+
+// Print the results as a single JSON line on stdout, so that
+// it can be collected by scripts while the UI stays on stderr
+void ConsolePlayer::benchReport() {
+	const double wall	  = toMs(bench_clock::now() - m_bench.started);
+	const double emulated = m_engine.timeMs();
+	const double seconds  = wall / 1000.;
+
+	const char *md5 = m_tune.createMD5New();
+	const char *builder = m_engCfg.sidEmulation ?
+		m_engCfg.sidEmulation->name() : "none";
+
+	cout << std::fixed << std::setprecision(3)
+		 << "{\"md5\":\"" << (md5 ? md5 : "") << "\""
+		 << ",\"subtune\":" << m_tune.getInfo()->currentSong()
+		 << ",\"engine\":\"" << builder << "\""
+		 << ",\"frequency\":" << m_driver.cfg.sampleRate
+		 << ",\"channels\":" << static_cast<unsigned int>(m_driver.cfg.channels)
+		 << ",\"emulated_ms\":" << emulated
+		 << ",\"wall_ms\":" << wall
+		 << ",\"realtime_factor\":" << (wall > 0. ? emulated / wall : 0.)
+		 << ",\"cycles_per_sec\":" << (seconds > 0. ? m_bench.cycles / seconds : 0.)
+		 << ",\"samples_per_sec\":" << (seconds > 0. ? m_bench.samples / seconds : 0.)
+		 << ",\"emulation_ms\":" << toMs(m_bench.emulation)
+		 << ",\"mixing_ms\":" << toMs(m_bench.mixing)
+		 << ",\"output_ms\":" << toMs(m_bench.output)
+		 << ",\"pcm_hash\":\"" << std::hex << std::setw(16) << std::setfill('0')
+		 << m_bench.hash << std::dec << "\""
+		 << "}" << endl;
+}
@@ -0,0 +1,252 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "cache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+#include "ini/types.h"
+
+const char RenderCache::MAGIC[8] = { 'C','6','4','P','C','M','0','1' };
+
+RenderCache::RenderCache() :
+	m_state(IDLE),
+	m_samples(0),
+	m_loop(0),
+	m_replay(nullptr),
+	m_toMemory(false) {}
+
+bool RenderCache::makeDir(const std::string &path) {
+	return (mkdir(path.c_str(), 0755) == 0) || (errno == EEXIST);
+}
+
+// 64-bit FNV-1a, good enough for naming files
+std::string RenderCache::hashKey(const std::string &key) {
+	uint_least64_t hash = 0xcbf29ce484222325ULL;
+
+	for (const unsigned char c : key)
+		hash = (hash ^ c) * 0x100000001b3ULL;
+
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return name.str();
+}
+
+bool RenderCache::open(const std::string &key, bool disk, bool memory) {
+	close();
+
+	m_key = key;
+
+	if (!m_memory.empty() && (m_memoryKey == key)) {
+		m_replay = &m_memory;
+		m_state  = REPLAYING;
+		return true;
+	}
+
+	// Something else is playing now
+	forget();
+
+	if (disk && openFile(key))
+		return true;
+
+	m_toMemory = memory;
+
+	if (m_toMemory || m_out.is_open())
+		m_state = CAPTURING;
+
+	return false;
+}
+
+bool RenderCache::openFile(const std::string &key) {
+	std::string dir;
+	try {
+		dir = utils::getCachePath();
+	}
+	catch (utils::error const &e) {
+		return false;
+	}
+
+	if (!makeDir(dir))
+		return false;
+
+	dir.append(SEPARATOR).append("C64play");
+	if (!makeDir(dir))
+		return false;
+
+	m_path = dir + SEPARATOR + hashKey(key) + ".pcm";
+
+	// Try replaying an existing render
+	m_in.open(m_path.c_str(), std::ios::in|std::ios::binary);
+	if (m_in.is_open()) {
+		char magic[sizeof(MAGIC)];
+		uint32_t length = 0;
+
+		m_in.read(magic, sizeof(magic));
+		m_in.read((char*)&length, sizeof(length));
+
+		if (m_in && (std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0)
+				&& (length == key.length())) {
+			std::string stored(length, '\0');
+			m_in.read(&stored[0], length);
+
+			if (m_in && (stored == key)) {
+				m_state = REPLAYING;
+				return true;
+			}
+		}
+
+		// Stale or colliding entry, render it again
+		m_in.close();
+	}
+
+	// Not there, capture it while it's being played
+	m_out.open(tempPath().c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+	if (!m_out.is_open())
+		return false;
+
+	const uint32_t length = key.length();
+	m_out.write(MAGIC, sizeof(MAGIC));
+	m_out.write((const char*)&length, sizeof(length));
+	m_out.write(key.data(), length);
+
+	return false;
+}
+
+void RenderCache::close() {
+	if (m_in.is_open())
+		m_in.close();
+
+	if (m_out.is_open()) {
+		m_out.close();
+		std::remove(tempPath().c_str());
+	}
+
+	m_capture.clear();
+	m_replay   = nullptr;
+	m_toMemory = false;
+	m_state    = IDLE;
+	m_samples  = 0;
+	m_loop     = 0;
+}
+
+void RenderCache::read(short *buffer, uint_least32_t size) {
+	uint_least32_t got = 0;
+
+	if (m_replay) {
+		const uint_least64_t total = m_replay->size();
+
+		while (got < size) {
+			// Go around to the start of the loop
+			if ((m_samples >= total) && m_loop)
+				m_samples -= m_loop;
+
+			if (m_samples >= total)
+				break;
+
+			const uint_least32_t count = std::min<uint_least64_t>(size - got, total - m_samples);
+			std::memcpy(buffer + got, m_replay->data() + m_samples, count * sizeof(short));
+
+			got		  += count;
+			m_samples += count;
+		}
+	} else {
+		m_in.read((char*)buffer, size * sizeof(short));
+		got = m_in.gcount() / sizeof(short);
+
+		m_samples += got;
+	}
+
+	if (got < size) {
+		std::memset(buffer + got, 0, (size - got) * sizeof(short));
+		m_samples += size - got;
+	}
+}
+
+bool RenderCache::loop(uint_least64_t length) {
+	if (!m_replay || !length || (length > m_replay->size()))
+		return false;
+
+	m_loop	  = length;
+	m_samples = m_replay->size() - length;
+
+	return true;
+}
+
+bool RenderCache::commitLoop(uint_least64_t length) {
+	if ((m_state != CAPTURING) || !m_toMemory || !length || (length > m_capture.size()))
+		return false;
+
+	commit();
+
+	m_replay = &m_memory;
+	m_state  = REPLAYING;
+	return loop(length);
+}
+
+void RenderCache::write(const short *buffer, uint_least32_t size) {
+	if (m_toMemory)
+		m_capture.insert(m_capture.end(), buffer, buffer + size);
+
+	if (m_out.is_open()) {
+		m_out.write((const char*)buffer, size * sizeof(short));
+
+		// Out of disk space or similar, don't leave a broken entry
+		if (m_out.fail()) {
+			m_out.close();
+			std::remove(tempPath().c_str());
+		}
+	}
+
+	m_samples += size;
+}
+
+void RenderCache::forget() {
+	m_memoryKey.clear();
+	m_memory.clear();
+	m_memory.shrink_to_fit();
+}
+
+void RenderCache::commit() {
+	if (m_state != CAPTURING)
+		return;
+
+	if (m_out.is_open()) {
+		m_out.close();
+
+		if (m_out.fail() || (std::rename(tempPath().c_str(), m_path.c_str()) != 0))
+			std::remove(tempPath().c_str());
+	}
+
+	if (m_toMemory) {
+		m_memoryKey = m_key;
+		m_memory.swap(m_capture);
+	}
+
+	close();
+}
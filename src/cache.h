@@ -0,0 +1,123 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * On-disk cache of rendered tunes.
+ *
+ * Renders are stored as the mixer's output under
+ * $XDG_CACHE_HOME/C64play, named after a hash of a key that
+ * describes everything that affects the sound. The key itself
+ * is stored in the file too, so collisions are detected.
+ * Samples are kept in host byte order, the cache isn't meant
+ * to be shared between machines.
+ *
+ * A render can also be kept in memory, which is what loop mode
+ * uses so that only the first pass has to be emulated. Only the
+ * one for the current key is kept, anything else is a different
+ * tune or different settings and would only pile up.
+ */
+class RenderCache {
+private:
+	static const char MAGIC[8];
+
+	enum state_t {
+		IDLE,
+		REPLAYING,
+		CAPTURING
+	};
+
+	std::string    m_key;
+	std::string    m_path; // final file name
+	std::ifstream  m_in;
+	std::ofstream  m_out;
+	state_t        m_state;
+	uint_least64_t m_samples; // read or written so far
+	uint_least64_t m_loop;	  // replayed over and over at the end
+
+	// The last finished render, kept around for loop mode
+	std::string				  m_memoryKey;
+	std::vector<short>		  m_memory;
+	std::vector<short>		  m_capture;
+	const std::vector<short> *m_replay;
+	bool					  m_toMemory;
+
+private:
+	static bool makeDir(const std::string &path);
+	static std::string hashKey(const std::string &key);
+
+	bool openFile(const std::string &key);
+
+	std::string tempPath() const { return m_path + ".tmp"; }
+
+public:
+	RenderCache();
+	~RenderCache() { close(); }
+
+	// Look the render described by key up, in memory first and
+	// then on disk if asked to. Returns true if it's there and
+	// ready to be read, otherwise a new capture is started
+	// and false is returned.
+	bool open(const std::string &key, bool disk, bool memory);
+
+	// Drop whatever we were doing, an unfinished capture
+	// is thrown away.
+	void close();
+
+	// Read size samples, the end is padded with silence
+	// if the render is shorter than expected.
+	void read(short *buffer, uint_least32_t size);
+
+	void write(const short *buffer, uint_least32_t size);
+
+	// The render went all the way, make it available.
+	void commit();
+
+	// Keep replaying the last length samples of a render that's
+	// in memory, starting from there. Returns false if it's not.
+	bool loop(uint_least64_t length);
+
+	// Commit a capture kept in memory and go straight on to
+	// replay its loop, as loop() does. False, and nothing done,
+	// if it isn't being kept in memory.
+	bool commitLoop(uint_least64_t length);
+
+	// Drop the render kept in memory.
+	void forget();
+
+	bool replaying() const { return m_state == REPLAYING; }
+	bool capturing() const { return m_state == CAPTURING; }
+
+	uint_least64_t position() const { return m_samples; }
+
+	// Samples in the render kept in memory, or in the capture
+	// going into it so far.
+	uint_least64_t length() const { return m_replay ? m_replay->size() : m_capture.size(); }
+};
+
+#endif // CACHE_H
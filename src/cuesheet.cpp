@@ -0,0 +1,78 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "cuesheet.h"
+
+#include <fstream>
+#include <iomanip>
+
+void CueSheet::clear() {
+	m_title.clear();
+	m_performer.clear();
+	m_tracks.clear();
+}
+
+void CueSheet::setInfo(const char *title, const char *performer) {
+	m_title		= title;
+	m_performer = performer;
+}
+
+void CueSheet::addTrack(const std::string &title, uint_least64_t frame) {
+	m_tracks.push_back({ title, frame });
+}
+
+// Cue sheets have no escapes, so quotes can't be kept
+std::string CueSheet::quote(const std::string &text) {
+	std::string quoted("\"");
+
+	for (const char c : text)
+		quoted += (c == '"') ? '\'' : c;
+
+	return quoted + '"';
+}
+
+bool CueSheet::write(const std::string &path, const std::string &file,
+					 const char *type, uint_least32_t sampleRate) const {
+	std::ofstream out(path.c_str(), std::ios::out|std::ios::trunc);
+	if (!out.is_open())
+		return false;
+
+	if (!m_performer.empty())
+		out << "PERFORMER " << quote(m_performer) << "\n";
+	if (!m_title.empty())
+		out << "TITLE " << quote(m_title) << "\n";
+
+	out << "FILE " << quote(file) << ' ' << type << "\n";
+
+	unsigned int number = 1;
+	for (const track_t &track : m_tracks) {
+		const uint_least64_t cdFrames = track.frame * 75 / sampleRate;
+
+		out << "  TRACK " << std::setfill('0') << std::setw(2) << number++ << " AUDIO\n"
+			<< "    TITLE " << quote(track.title) << "\n"
+			<< "    INDEX 01 "
+			<< std::setw(2) << cdFrames / (75 * 60) << ':'
+			<< std::setw(2) << cdFrames / 75 % 60 << ':'
+			<< std::setw(2) << cdFrames % 75 << "\n";
+	}
+
+	return out.good();
+}
@@ -0,0 +1,67 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef CUESHEET_H
+#define CUESHEET_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * Cue sheet for a render of every subtune into one file, so
+ * players can show and seek to the subtunes as tracks.
+ *
+ * Track starts are kept in sample frames and converted to CD
+ * frames (1/75 s) when written. The strings are written as
+ * they come, which for SID tunes means Latin-1.
+ */
+class CueSheet {
+private:
+	struct track_t {
+		std::string	   title;
+		uint_least64_t frame; // first sample frame
+	};
+
+	std::string m_title;
+	std::string m_performer;
+	std::vector<track_t> m_tracks;
+
+private:
+	static std::string quote(const std::string &text);
+
+public:
+	void clear();
+
+	void setInfo(const char *title, const char *performer);
+
+	void addTrack(const std::string &title, uint_least64_t frame);
+
+	size_t tracks() const { return m_tracks.size(); }
+
+	// Write the sheet to path for the audio in file, which should
+	// be relative to the sheet. type is the cue FILE type.
+	bool write(const std::string &path, const std::string &file,
+			   const char *type, uint_least32_t sampleRate) const;
+};
+
+#endif // CUESHEET_H
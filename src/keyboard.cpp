@@ -285,6 +285,10 @@ void keyboard_enable_raw() {
 	tcsetattr(infd, TCSAFLUSH, &current);
 }
 
+int keyboard_fd() {
+	return infd;
+}
+
 void keyboard_disable_raw() {
 	if (infd >= 0) { // Restore old terminal settings
 		tcsetattr(infd, TCSAFLUSH, &term);
@@ -71,3 +71,5 @@ enum {
 int  keyboard_decode	 ();
 void keyboard_enable_raw ();
 void keyboard_disable_raw();
+// What keys are read from, -1 if there's no terminal
+int  keyboard_fd         ();
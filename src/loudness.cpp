@@ -0,0 +1,296 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2024-2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "loudness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#ifdef __SSE__
+#  include <xmmintrin.h>
+#endif
+
+#ifndef M_PI
+# define M_PI 3.14159265358979323846
+#endif
+
+LoudnessMeter::LoudnessMeter(uint_least32_t rate, unsigned int channels) :
+	m_channels(channels),
+	m_step(rate / 10),
+	m_state(channels * 4, 0.0),
+	m_history(channels * TAPS * 2, 0.f),
+	m_pos(0),
+	m_energy(0.0),
+	m_peak(0.f),
+	m_count(0) {
+	// K-weighting, a high shelf for the head and then a
+	// high pass, worked out for the rate in use as BS.1770
+	// only lists them for 48 kHz
+	double f0 = 1681.974450955533;
+	double q  = 0.7071752369554196;
+	double k  = std::tan(M_PI * f0 / rate);
+
+	const double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+	const double vb = std::pow(vh, 0.4996667741545416);
+
+	double a0 = 1.0 + k / q + k * k;
+	m_shelf.b0 = (vh + vb * k / q + k * k) / a0;
+	m_shelf.b1 = 2.0 * (k * k - vh) / a0;
+	m_shelf.b2 = (vh - vb * k / q + k * k) / a0;
+	m_shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+	m_shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+	f0 = 38.13547087602444;
+	q  = 0.5003270373238773;
+	k  = std::tan(M_PI * f0 / rate);
+
+	a0 = 1.0 + k / q + k * k;
+	m_highpass.b0 = 1.0;
+	m_highpass.b1 = -2.0;
+	m_highpass.b2 = 1.0;
+	m_highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+	m_highpass.a2 = (1.0 - k / q + k * k) / a0;
+
+	// Interpolation filter for the true peak, a windowed
+	// sinc split into one set of taps per phase. Taps are
+	// stored newest first to match the history.
+	const double centre = (PHASES * TAPS - 1) / 2.0;
+
+	for (unsigned int p = 0; p < PHASES; p++) {
+		double sum = 0.0;
+
+		for (unsigned int t = 0; t < TAPS; t++) {
+			const double x = (t * PHASES + p - centre) / PHASES;
+			const double w = 0.5 + 0.5 * std::cos(M_PI * (t * PHASES + p - centre) / (centre + 1));
+			const double h = (x == 0.0) ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+
+			m_fir[t][p] = h * w;
+			sum += h * w;
+		}
+
+		// Unity gain for every phase
+		for (unsigned int t = 0; t < TAPS; t++)
+			m_fir[t][p] /= sum;
+	}
+}
+
+// The filters run one sample after the other, the true peak
+// works out all its phases side by side
+void LoudnessMeter::feed(const short *samples, uint_least32_t frames) {
+	for (uint_least32_t i = 0; i < frames; i++) {
+		m_pos = (m_pos + TAPS - 1) % TAPS;
+
+		for (unsigned int c = 0; c < m_channels; c++) {
+			const double x = samples[i * m_channels + c] / 32768.0;
+
+			// Transposed direct form II for both stages
+			double *z = &m_state[c * 4];
+
+			const double y1 = m_shelf.b0 * x + z[0];
+			z[0] = m_shelf.b1 * x - m_shelf.a1 * y1 + z[1];
+			z[1] = m_shelf.b2 * x - m_shelf.a2 * y1;
+
+			const double y2 = m_highpass.b0 * y1 + z[2];
+			z[2] = m_highpass.b1 * y1 - m_highpass.a1 * y2 + z[3];
+			z[3] = m_highpass.b2 * y1 - m_highpass.a2 * y2;
+
+			m_energy += y2 * y2;
+
+			// True peak, the newest sample first
+			float *history = &m_history[c * TAPS * 2];
+			history[m_pos] = history[m_pos + TAPS] = x;
+
+			const float *window = history + m_pos;
+#ifdef __SSE__
+			static_assert(PHASES == 4, "One phase per lane");
+
+			__m128 y = _mm_setzero_ps();
+			for (unsigned int t = 0; t < TAPS; t++)
+				y = _mm_add_ps(y, _mm_mul_ps(_mm_load_ps(m_fir[t]), _mm_set1_ps(window[t])));
+
+			// Clearing the sign bits gives the magnitudes
+			y = _mm_andnot_ps(_mm_set1_ps(-0.f), y);
+			y = _mm_max_ps(y, _mm_movehl_ps(y, y));
+			y = _mm_max_ss(y, _mm_shuffle_ps(y, y, 1));
+			m_peak = std::max(m_peak, _mm_cvtss_f32(y));
+#else
+			float y[PHASES] = {};
+			for (unsigned int t = 0; t < TAPS; t++)
+				for (unsigned int p = 0; p < PHASES; p++)
+					y[p] += m_fir[t][p] * window[t];
+
+			for (unsigned int p = 0; p < PHASES; p++)
+				m_peak = std::max(m_peak, std::fabs(y[p]));
+#endif
+		}
+
+		if (++m_count == m_step) {
+			m_energies.push_back(m_energy / m_step);
+			m_peaks.push_back(m_peak);
+
+			m_energy = 0.0;
+			m_peak	 = 0.f;
+			m_count  = 0;
+		}
+	}
+}
+
+double LoudnessMeter::loudness(double energy) {
+	return (energy > 0.0) ?
+		std::max(-0.691 + 10.0 * std::log10(energy), SILENT) : SILENT;
+}
+
+LoudnessMeter::result_t LoudnessMeter::result(uint_least64_t frames) const {
+	const size_t steps = std::min<uint_least64_t>(frames / m_step, m_energies.size());
+
+	result_t result = { SILENT, 0.0, SILENT };
+
+	// Blocks of 400 ms, overlapping by 75%, and short-term
+	// windows of 3 s for the range, both gated at -70 LUFS
+	std::vector<double> blocks, shortTerm;
+
+	double window = 0.0;
+	for (size_t i = 0; i < steps; i++) {
+		window += m_energies[i];
+		if (i >= 30)
+			window -= m_energies[i - 30];
+
+		if (i >= 3) {
+			const double block = (m_energies[i] + m_energies[i - 1]
+				+ m_energies[i - 2] + m_energies[i - 3]) / 4.0;
+			if (loudness(block) > SILENT)
+				blocks.push_back(block);
+		}
+
+		if ((i >= 29) && (loudness(window / 30.0) > SILENT))
+			shortTerm.push_back(window / 30.0);
+	}
+
+	// Then relative to their mean, by 10 LU for the integrated
+	// loudness and by 20 LU for the range
+	if (!blocks.empty()) {
+		double sum = 0.0;
+		for (const double block : blocks)
+			sum += block;
+
+		const double gate = loudness(sum / blocks.size()) - 10.0;
+
+		double gated = 0.0;
+		size_t count = 0;
+		for (const double block : blocks) {
+			if (loudness(block) > gate) {
+				gated += block;
+				count++;
+			}
+		}
+
+		if (count)
+			result.integrated = loudness(gated / count);
+	}
+
+	if (!shortTerm.empty()) {
+		double sum = 0.0;
+		for (const double energy : shortTerm)
+			sum += energy;
+
+		const double gate = loudness(sum / shortTerm.size()) - 20.0;
+
+		std::vector<double> levels;
+		for (const double energy : shortTerm) {
+			if (loudness(energy) > gate)
+				levels.push_back(loudness(energy));
+		}
+
+		if (!levels.empty()) {
+			std::sort(levels.begin(), levels.end());
+
+			const size_t low  = std::lround(0.10 * (levels.size() - 1));
+			const size_t high = std::lround(0.95 * (levels.size() - 1));
+			result.range = levels[high] - levels[low];
+		}
+	}
+
+	float peak = 0.f;
+	for (size_t i = 0; i < steps; i++)
+		peak = std::max(peak, m_peaks[i]);
+
+	if (peak > 0.f)
+		result.truePeak = std::max(20.0 * std::log10(peak), SILENT);
+
+	return result;
+}
+
+bool LoudnessDatabase::open(const std::string &path) {
+	std::ifstream in(path.c_str());
+	if (!in.is_open())
+		return false;
+
+	m_tunes.clear();
+
+	std::string line;
+	while (std::getline(in, line)) {
+		// Comments and sections
+		if (line.empty() || (line[0] == ';') || (line[0] == '['))
+			continue;
+
+		const size_t equals = line.find('=');
+		if (equals == std::string::npos)
+			continue;
+
+		std::vector<LoudnessMeter::result_t> &songs = m_tunes[line.substr(0, equals)];
+		songs.clear();
+
+		std::istringstream values(line.substr(equals + 1));
+		std::string entry;
+
+		while (values >> entry) {
+			LoudnessMeter::result_t result;
+
+			if (std::sscanf(entry.c_str(), "%lf,%lf,%lf", &result.integrated,
+					&result.range, &result.truePeak) != 3)
+				break;
+
+			songs.push_back(result);
+		}
+	}
+
+	return true;
+}
+
+bool LoudnessDatabase::lookup(const char *md5, unsigned int song, LoudnessMeter::result_t &result) const {
+	const auto it = m_tunes.find(md5);
+	if ((it == m_tunes.end()) || !song || (song > it->second.size()))
+		return false;
+
+	result = it->second[song - 1];
+	return true;
+}
+
+void LoudnessDatabase::write(std::ostream &out, const LoudnessMeter::result_t &result) {
+	char buffer[64];
+
+	std::snprintf(buffer, sizeof(buffer), "%.2f,%.2f,%.2f",
+				  result.integrated, result.range, result.truePeak);
+
+	out << buffer;
+}
@@ -0,0 +1,120 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2024-2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef LOUDNESS_H
+#define LOUDNESS_H
+
+#include <stdint.h>
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Loudness measurement after EBU R 128 (ITU-R BS.1770).
+ *
+ * Interleaved samples are K-weighted and kept as the energy
+ * of every 100 ms, along with their true peak, so results can
+ * be had for any length measured so far. That's what lets the
+ * analyzer stop at the end it finds after running past it.
+ */
+class LoudnessMeter {
+public:
+	struct result_t {
+		double integrated; // LUFS
+		double range;	   // LU
+		double truePeak;   // dBTP
+	};
+
+	// Floor for silence, both in LUFS and dBTP
+	static constexpr double SILENT = -70.0;
+
+	// ReplayGain 2.0 reference level
+	static constexpr double REFERENCE = -18.0;
+
+private:
+	// 4x oversampling for the true peak
+	static constexpr unsigned int PHASES = 4;
+	static constexpr unsigned int TAPS	 = 12;
+
+	struct biquad_t {
+		double b0, b1, b2, a1, a2;
+	};
+
+	const unsigned int	 m_channels;
+	const uint_least32_t m_step; // frames in 100 ms
+
+	biquad_t m_shelf;
+	biquad_t m_highpass;
+
+	// Filter state, two per stage for every channel
+	std::vector<double> m_state;
+
+	// Last TAPS input samples of every channel, stored
+	// twice so that a window of them is always contiguous
+	std::vector<float> m_history;
+	unsigned int	   m_pos;
+
+	// Laid out by tap, so that every phase of a tap is
+	// worked out at once
+	alignas(16) float m_fir[TAPS][PHASES];
+
+	double		   m_energy;
+	float		   m_peak;
+	uint_least32_t m_count;
+
+	std::vector<double> m_energies; // mean square of every 100 ms
+	std::vector<float>	m_peaks;
+
+private:
+	static double loudness(double energy);
+
+public:
+	LoudnessMeter(uint_least32_t rate, unsigned int channels);
+
+	void feed(const short *samples, uint_least32_t frames);
+
+	// Results for the first frames measured
+	result_t result(uint_least64_t frames) const;
+
+	static double replayGain(const result_t &result) {
+		return REFERENCE - result.integrated;
+	}
+};
+
+/*
+ * Loudness of known tunes, as written by --loudness.
+ * Laid out like Songlengths.md5, with each subtune given
+ * as integrated loudness, range and true peak.
+ */
+class LoudnessDatabase {
+private:
+	std::unordered_map<std::string, std::vector<LoudnessMeter::result_t>> m_tunes;
+
+public:
+	bool open(const std::string &path);
+
+	bool lookup(const char *md5, unsigned int song, LoudnessMeter::result_t &result) const;
+
+	static void write(std::ostream &out, const LoudnessMeter::result_t &result);
+};
+
+#endif // LOUDNESS_H
@@ -48,6 +48,12 @@ int main(int argc, char *argv[]) {
 			goto main_exit;
 	}
 
+	if (player.analyzing()) {
+		if (!player.analyze())
+			goto main_error;
+		goto main_exit;
+	}
+
 main_restart:
 	if (!player.open())
 		goto main_error;
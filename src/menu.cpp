@@ -437,6 +437,19 @@ void ConsolePlayer::menu() {
 		consoleColor(m_iniCfg.console().chip_text);
 		cerr << (info.channels() == 1 ? "Mono" : "Stereo") << endl;
 
+		// What the sound card agreed to
+		if (((m_driver.output == OUT_SOUNDCARD) || (m_driver.output == OUT_SIM)
+			|| m_driver.monitor) && m_driver.cfg.bufferTime) {
+			consoleTable(middle);
+			consoleColor(m_iniCfg.console().chip_label);
+			cerr << " Latency      : ";
+			consoleColor(m_iniCfg.console().chip_text);
+			cerr << (m_driver.cfg.bufferTime + 50) / 1000 << '.'
+				 << (m_driver.cfg.bufferTime + 50) / 100 % 10 << " ms, "
+				 << (m_driver.cfg.periodTime + 50) / 1000 << '.'
+				 << (m_driver.cfg.periodTime + 50) / 100 % 10 << " ms periods" << endl;
+		}
+
 		consoleTable(middle);
 		consoleColor(m_iniCfg.console().chip_label);
 		cerr << " SID Model    : ";
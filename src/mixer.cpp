@@ -23,18 +23,29 @@
 
 #include "mixer.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <type_traits>
 
-Mixer::Mixer() : m_rand(257254) { setVolume(VOLUME_MAX); }
+Mixer::Mixer() : m_rand(DITHER_SEED) { setVolume(VOLUME_MAX); }
 
-void Mixer::initialize(unsigned int chips, bool stereo) {
+void Mixer::initialize(unsigned int chips, bool stereo, unsigned int bits) {
 	assert((chips >= 1) && (chips <= 3));
+	assert(((bits >= 16) && (bits <= 24)) || (bits == 32));
 	m_channels = stereo ? 2 : 1;
+	m_extraBits = std::min(bits, 24u) - 16;
+	m_padBits = bits - (16 + m_extraBits);
 	m_mix.resize(m_channels);
 	m_chips = chips;
 	m_iSamples.resize(chips);
 
+	// restart the dithering sequence so that every
+	// tune gets rendered the same way regardless of
+	// what was played before
+	m_rand = randomLCG<VOLUME_MAX>(DITHER_SEED);
+	m_oldRandomVal = 0;
+
 	switch (chips) {
 	case 1:
 		m_mix[0] = stereo ? &Mixer::stereo_OneChip : &Mixer::template mono<1>;
@@ -55,20 +66,58 @@ void Mixer::initialize(unsigned int chips, bool stereo) {
 
 void Mixer::begin(short *buffer, uint_least32_t length) {
 	m_dest = buffer;
+	m_wideDest = nullptr;
+	m_floatDest = nullptr;
+	m_dest_size = length;
+
+	m_pos = std::min<uint_least32_t>(m_buffer.size(), length);
+
+	for (uint_least32_t i = 0; i < m_pos; i++)
+		m_dest[i] = static_cast<short>(m_buffer[i]);
+
+	keepRest();
+}
+
+void Mixer::begin(int_least32_t *buffer, uint_least32_t length) {
+	m_dest = nullptr;
+	m_wideDest = buffer;
+	m_floatDest = nullptr;
 	m_dest_size = length;
 
-	m_pos = m_buffer.size();
+	m_pos = std::min<uint_least32_t>(m_buffer.size(), length);
 
 	if (m_pos) LIKELY
-		std::memcpy(m_dest, m_buffer.data(), m_pos*sizeof(short));
+		std::memcpy(m_wideDest, m_buffer.data(), m_pos*sizeof(int_least32_t));
+
+	keepRest();
+}
+
+void Mixer::begin(float *buffer, uint_least32_t length) {
+	m_dest = nullptr;
+	m_wideDest = nullptr;
+	m_floatDest = buffer;
+	m_dest_size = length;
+
+	m_pos = std::min<uint_least32_t>(m_buffer.size(), length);
+
+	for (uint_least32_t i = 0; i < m_pos; i++)
+		m_floatDest[i] = toFloat(m_buffer[i]);
+
+	keepRest();
+}
+
+// Leftovers that didn't fit wait for the next buffer
+void Mixer::keepRest() {
+	m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_pos);
 }
 
-uint_least32_t Mixer::mix(short** buffers, uint_least32_t start, uint_least32_t length, short* dest) {
+template <typename T>
+uint_least32_t Mixer::mix(short** buffers, uint_least32_t start, uint_least32_t length, T* dest) {
 	uint_least32_t j = 0;
 	for (uint_least32_t i = 0; i < length;) {
 		if (m_fastForwardFactor == 1) LIKELY {
             for (unsigned int c = 0; c < m_chips; ++c) {
-				m_iSamples[c] = buffers[c][start+i];
+				m_iSamples[c] = buffers[c][start+i] * (1 << m_extraBits);
             }
 
 			++i;
@@ -81,7 +130,7 @@ uint_least32_t Mixer::mix(short** buffers, uint_least32_t start, uint_least32_t
 					sample += buffer[k];
 				}
 			
-				m_iSamples[c] = sample / m_fastForwardFactor;
+				m_iSamples[c] = sample * (1 << m_extraBits) / static_cast<int_least32_t>(m_fastForwardFactor);
 			}
 
 			// increment i to mark we ate some samples
@@ -90,8 +139,14 @@ uint_least32_t Mixer::mix(short** buffers, uint_least32_t start, uint_least32_t
 
 		for (unsigned int c = 0; c < m_channels; ++c) {
 			const int_least32_t tmp = (this->*(m_scale))(c);
-			assert(tmp >= -32768 && tmp <= 32767);
-			dest[j++] = static_cast<short>(tmp);
+			assert((tmp >> m_extraBits) >= -32768 && (tmp >> m_extraBits) <= 32767);
+
+			if constexpr (std::is_same_v<T, float>)
+				dest[j++] = toFloat(tmp);
+			else if constexpr (std::is_same_v<T, int_least32_t>)
+				dest[j++] = static_cast<int_least32_t>(static_cast<uint_least32_t>(tmp) << m_padBits);
+			else
+				dest[j++] = static_cast<T>(tmp);
 		}
 	}
 
@@ -100,14 +155,16 @@ uint_least32_t Mixer::mix(short** buffers, uint_least32_t start, uint_least32_t
 
 void Mixer::doMix(short** buffers, uint_least32_t samples) {
 	uint_least32_t const cnt = std::min(samples, (m_dest_size-m_pos)/m_channels);
-    uint_least32_t const res = mix(buffers, 0, cnt, m_dest+m_pos);
+    uint_least32_t const res = m_floatDest ? mix(buffers, 0, cnt, m_floatDest+m_pos)
+		: m_wideDest ? mix(buffers, 0, cnt, m_wideDest+m_pos) : mix(buffers, 0, cnt, m_dest+m_pos);
     m_pos += res;
 
-	// save remaining samples, if any
+	// save remaining samples, if any, after those still waiting
 	uint_least32_t const rem = static_cast<std::size_t>(samples - cnt);
 	if (rem) {
-		m_buffer.resize(static_cast<std::size_t>(rem) * m_channels);
-		mix(buffers, cnt, rem, m_buffer.data());
+		const std::size_t kept = m_buffer.size();
+		m_buffer.resize(kept + static_cast<std::size_t>(rem) * m_channels);
+		m_buffer.resize(kept + mix(buffers, cnt, rem, m_buffer.data() + kept));
 	}
 }
 
@@ -60,6 +60,8 @@ private:
 private:
 	static constexpr int_least32_t SCALE_FACTOR = 1 << 16;
 
+	static constexpr uint32_t DITHER_SEED = 257254;
+
 #if defined(HAVE_CXX20) && defined(__cpp_lib_math_constants)
 	static constexpr double SQRT_2 = std::numbers::sqrt2;
 	static constexpr double SQRT_3 = std::numbers::sqrt3;
@@ -90,17 +92,24 @@ private:
 	uint_least32_t m_dest_size = 0;
 
 	short* m_dest = nullptr;
+	int_least32_t* m_wideDest = nullptr;
+	float* m_floatDest = nullptr;
 
 	unsigned int m_channels = 1;
 	unsigned int m_chips;
 	int			 m_oldRandomVal = 0;
 	unsigned int m_fastForwardFactor = 1;
 
+	// Bits kept below the chips' 16 for wider output
+	unsigned int m_extraBits = 0;
+	// Zeros below those, for full 32-bit words
+	unsigned int m_padBits = 0;
+
 	int_least32_t m_volume;
 	scale_func_t  m_scale;
 
 	std::vector<int_least32_t> m_iSamples;
-	std::vector<short> m_buffer;
+	std::vector<int_least32_t> m_buffer;
 	std::vector<mixer_func_t> m_mix;
 
 	randomLCG<VOLUME_MAX> m_rand;
@@ -113,9 +122,10 @@ private:
 		return static_cast<int_least32_t>(m_oldRandomVal - prevValue);
 	}
 
+	// Dithering is at the output's LSB, whatever its width
 	int scale(unsigned int ch) {
-		const int_least32_t sample = (this->*(m_mix[ch]))();
-		return (sample * m_volume + triangularDithering()) / VOLUME_MAX;
+		const int_least64_t sample = (this->*(m_mix[ch]))();
+		return static_cast<int>((sample * m_volume + triangularDithering()) / VOLUME_MAX);
 	}
 
 	int noScale(unsigned int ch) {
@@ -146,7 +156,7 @@ private:
 		for (unsigned int i = 0; i < Chips; ++i)
 			res += m_iSamples[i];
 
-		return res * SCALE[Chips-1] / SCALE_FACTOR;
+		return static_cast<int_least64_t>(res) * SCALE[Chips-1] / SCALE_FACTOR;
 	}
 
 	// Stereo mixing
@@ -168,15 +178,35 @@ private:
 		return (0.5*m_iSamples[0] + m_iSamples[1] + m_iSamples[2]) * SCALE[2] / SCALE_FACTOR;
 	}
 
-	inline uint_least32_t mix(short** buffers, uint_least32_t start, uint_least32_t length, short* dest);
+	// Full scale floats from the mixed samples
+	float toFloat(int_least32_t sample) const {
+		return static_cast<float>(sample) * (1.f / (1 << (15 + m_extraBits)));
+	}
+
+	void keepRest();
+
+	template <typename T>
+	inline uint_least32_t mix(short** buffers, uint_least32_t start, uint_least32_t length, T* dest);
 
 public:
 	Mixer();
 
-	void initialize(unsigned int chips, bool stereo);
+	/**
+	 * Set up for a tune.
+	 *
+	 * @param bits sample size of the output, 16 to 24, or 32
+	 *        for full 32-bit words with 24 significant bits
+	 */
+	void initialize(unsigned int chips, bool stereo, unsigned int bits = 16);
 
 	void begin(short* buffer, uint_least32_t length);
 
+	// For output wider than 16 bits, as set by initialize()
+	void begin(int_least32_t* buffer, uint_least32_t length);
+
+	// Floats from -1 to 1, at the precision set by initialize()
+	void begin(float* buffer, uint_least32_t length);
+
 	void doMix(short** buffers, uint_least32_t samples);
 
 	bool isFull() const { return m_pos >= m_dest_size; }
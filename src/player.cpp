@@ -22,6 +22,8 @@
 
 #include "player.h"
 
+#include <algorithm>
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
@@ -33,6 +35,7 @@
 #include <new>
 #include <unordered_map>
 
+#include <poll.h>
 #include <unistd.h>
 
 #include <sidplayfp/sidbuilder.h>
@@ -46,6 +49,10 @@ using std::endl;
 #include "keyboard.h"
 #include "audio/AudioDrv.h"
 #include "audio/wav/WavFile.h"
+#include "audio/flac/FlacFile.h"
+#include "audio/raw/RawFile.h"
+#include "audio/sim/sim.h"
+#include "audio/tee/tee.h"
 #include "ini/types.h"
 
 #include "sidcxx.h"
@@ -159,9 +166,11 @@ ConsolePlayer::ConsolePlayer(const char * const name) :
 	// Other defaults
 	m_filter.enabled = true;
 	m_driver.device  = nullptr;
+	m_driver.samples = SAMPLES_S16;
 	m_driver.sid	 = EMU_RESIDFP;
 	m_timer.start	 = 0;
 	m_timer.length	 = 0; // infinite play time by default
+	m_timer.defaultLength = 0;
 	m_timer.valid	 = false;
 	m_timer.starting = false;
 	m_track.first	 = 0;
@@ -170,6 +179,18 @@ ConsolePlayer::ConsolePlayer(const char * const name) :
 	m_track.single	 = false;
 	m_speed.current  = 1;
 	m_speed.max		 = 32;
+	m_bench.enabled  = false;
+	m_bench.fingerprint = false;
+	m_analysis.enabled  = false;
+	m_analysis.loudness = false;
+	m_loop.find         = false;
+	m_loop.found        = false;
+	m_loop.seamless     = false;
+	m_loop.song         = 0;
+	m_album.enabled     = false;
+	m_album.split       = false;
+	m_album.frames      = 0;
+	m_album.part        = nullptr;
 
 	// Read default configuration
 	m_iniCfg.read();
@@ -191,7 +212,15 @@ ConsolePlayer::ConsolePlayer(const char * const name) :
 		m_engCfg.fastSampling    = emulation.fastSampling;
 #endif
 		m_channels               = audio.channels;
+		m_engineRate             = 0;
 		m_bitDepth               = audio.bitDepth;
+		m_driver.bufferTime      = std::max(audio.bufferTime, 0) * 1000;
+		m_driver.periodTime      = std::max(audio.periodTime, 0) * 1000;
+		m_driver.lowLatency      = false;
+		m_driver.jitter          = 0;
+		m_driver.monitor         = false;
+		m_driver.splice          = false;
+		m_driver.stats           = false;
 		m_filter.enabled         = emulation.filter;
 
 #ifdef HAVE_SIDPLAYFP_BUILDERS_RESID_H
@@ -246,12 +275,32 @@ ConsolePlayer::ConsolePlayer(const char * const name) :
 	m_engine.setRoms(kernalRom.get(), basicRom.get(), chargenRom.get());
 }
 
-std::string ConsolePlayer::getFileName(const SidTuneInfo *tuneInfo, const char* ext) {
+// Drop the extension from a file name, if it has one
+static std::string stripExtension(const std::string &name) {
+	const size_t dot	= name.find_last_of('.');
+	const size_t folder = name.find_last_of(SEPARATOR[0]);
+
+	if ((dot == std::string::npos) || (dot == 0) ||
+		((folder != std::string::npos) && (dot <= folder + 1)))
+		return name;
+
+	return name.substr(0, dot);
+}
+
+// Name the output file. Subtunes split off an album are named
+// after the album's file, if it has one.
+std::string ConsolePlayer::getFileName(const SidTuneInfo *tuneInfo, const char* ext, bool subtune) {
 	std::string title;
 
-	if (m_outfile != nullptr) {
+	if ((m_outfile != nullptr) && !(subtune && (std::strcmp(m_outfile, "-") == 0))) {
 		title = m_outfile;
-		if (title.compare("-") != 0 &&
+		if (subtune) {
+			title = stripExtension(title);
+
+			std::ostringstream sstream;
+			sstream << "[" << tuneInfo->currentSong() << "]" << ext;
+			title.append(sstream.str());
+		} else if (title.compare("-") != 0 &&
 			title.find_last_of('.') == std::string::npos)
 			title.append(ext);
 	} else {
@@ -260,8 +309,8 @@ std::string ConsolePlayer::getFileName(const SidTuneInfo *tuneInfo, const char*
 
 		title.erase(title.find_last_of('.'));
 
-		// Change name based on subtune
-		if (tuneInfo->songs() > 1) {
+		// Change name based on subtune, unless they all go in
+		if (subtune || ((tuneInfo->songs() > 1) && !m_album.enabled)) {
 			std::ostringstream sstream;
 			sstream << "[" << tuneInfo->currentSong() << "]";
 			title.append(sstream.str());
@@ -289,7 +338,26 @@ bool ConsolePlayer::createOutput(OUTPUTS driver, const SidTuneInfo *tuneInfo) {
 	// Create audio driver
 	switch (driver) {
 	case OUT_NULL:
-		m_driver.device = &m_driver.null;
+		// Benchmarks still need the mixer to run, so
+		// give them a sink that actually has a buffer
+		if (m_bench.enabled && tuneInfo) {
+			try {
+				m_driver.device = new Audio_Null(true);
+			}
+			catch (std::bad_alloc const &ba) {
+				m_driver.device = nullptr;
+			}
+		} else
+			m_driver.device = &m_driver.null;
+	break;
+
+	case OUT_SIM:
+		try {
+			m_driver.device = new Audio_Sim(m_driver.jitter);
+		}
+		catch (std::bad_alloc const &ba) {
+			m_driver.device = nullptr;
+		}
 	break;
 
 	case OUT_SOUNDCARD:
@@ -302,13 +370,20 @@ bool ConsolePlayer::createOutput(OUTPUTS driver, const SidTuneInfo *tuneInfo) {
 	break;
 
 	case OUT_WAV:
+	case OUT_FLAC:
+	case OUT_RAW:
 		try {
-			std::string title = getFileName(tuneInfo, WavFile::extension());
-			WavFile* wav = new WavFile(title);
-			if (m_driver.info && (tuneInfo->numberOfInfoStrings() == 3))
-				wav->setInfo(tuneInfo->infoString(0), tuneInfo->infoString(1),
-							 tuneInfo->infoString(2));
-			m_driver.device = wav;
+			std::unique_ptr<IAudio> file(createFile(driver, tuneInfo, false));
+
+			// Listen to it while it's being written
+			if (file && m_driver.monitor) {
+				std::unique_ptr<IAudio> card(new audioDrv());
+				m_driver.device = new Audio_Tee(card.get(), file.get());
+				card.release();
+			} else
+				m_driver.device = file.get();
+
+			file.release();
 		}
 		catch (std::bad_alloc const &ba) {
 			m_driver.device = nullptr;
@@ -334,7 +409,11 @@ bool ConsolePlayer::createOutput(OUTPUTS driver, const SidTuneInfo *tuneInfo) {
 	m_driver.cfg.sampleRate = m_engCfg.frequency;
 	m_driver.cfg.channels	= m_channels ? m_channels : tuneChannels;
 	m_driver.cfg.depth		= m_bitDepth;
+	m_driver.cfg.floating	= true;
 	m_driver.cfg.bufSize	= 0; // Recalculate
+	m_driver.cfg.bufferTime = m_driver.bufferTime;
+	m_driver.cfg.periodTime = m_driver.periodTime;
+	m_driver.cfg.lowLatency = m_driver.lowLatency;
 
 	{	// Open the hardware
 		bool err = false;
@@ -342,7 +421,7 @@ bool ConsolePlayer::createOutput(OUTPUTS driver, const SidTuneInfo *tuneInfo) {
 			err = true;
 
 		// Can't open the same driver twice
-		if (driver != OUT_NULL) {
+		if (m_driver.device != &m_driver.null) {
 			if (!m_driver.null.open(m_driver.cfg))
 				err = true;
 		}
@@ -354,7 +433,15 @@ bool ConsolePlayer::createOutput(OUTPUTS driver, const SidTuneInfo *tuneInfo) {
 		}
 	}
 
-	// See what we got
+	// See what we got. Sound cards take 32 bits straight from
+	// the mixer, WAV files turn 16-bit samples into floats.
+	if (m_driver.cfg.depth == 24)
+		m_driver.samples = SAMPLES_S24;
+	else if ((m_driver.cfg.depth == 32) && (driver == OUT_SOUNDCARD))
+		m_driver.samples = m_driver.cfg.floating ? SAMPLES_FLOAT : SAMPLES_S32;
+	else
+		m_driver.samples = SAMPLES_S16;
+
 	m_engCfg.frequency = m_driver.cfg.sampleRate;
 	switch (m_driver.cfg.channels) {
 	case 1:
@@ -376,6 +463,59 @@ bool ConsolePlayer::createOutput(OUTPUTS driver, const SidTuneInfo *tuneInfo) {
 }
 
 
+// Create a file output for the tune, or for just the
+// current subtune when an album is being split
+IAudio* ConsolePlayer::createFile(OUTPUTS driver, const SidTuneInfo *tuneInfo, bool subtune) {
+	const bool album = m_album.enabled && !subtune;
+
+	const char* ext = (driver == OUT_WAV) ? WavFile::extension()
+		: (driver == OUT_FLAC) ? FlacFile::extension() : RawFile::extension();
+	const std::string title = getFileName(tuneInfo, ext, subtune);
+
+	if (album)
+		m_album.name = title;
+
+	// Tag it with what --loudness measured earlier,
+	// which doesn't cover a whole album
+	LoudnessMeter::result_t loudness;
+	const bool gain = m_driver.info && !album && m_loudness.lookup(
+		m_tune.createMD5New(), tuneInfo->currentSong(), loudness);
+	const bool info = m_driver.info && (tuneInfo->numberOfInfoStrings() == 3);
+
+	switch (driver) {
+	case OUT_WAV:
+	{
+		WavFile* wav = new WavFile(title);
+		if (info)
+			wav->setInfo(tuneInfo->infoString(0), tuneInfo->infoString(1),
+						 tuneInfo->infoString(2));
+		if (gain)
+			wav->setReplayGain(LoudnessMeter::replayGain(loudness),
+							   std::pow(10.0, loudness.truePeak / 20.0));
+		return wav;
+	}
+
+	case OUT_FLAC:
+	{
+		FlacFile* flac = new FlacFile(title);
+		if (info)
+			flac->setInfo(tuneInfo->infoString(0), tuneInfo->infoString(1),
+						  tuneInfo->infoString(2));
+		if (gain)
+			flac->setReplayGain(LoudnessMeter::replayGain(loudness),
+								std::pow(10.0, loudness.truePeak / 20.0));
+		return flac;
+	}
+
+	case OUT_RAW:
+		return new RawFile(title, m_driver.splice);
+
+	default:
+		return nullptr;
+	}
+}
+
+
 // Create SID emulation
 bool ConsolePlayer::createSidEmu(SIDEMUS emu, const SidTuneInfo *tuneInfo) {
 	// Remove the old driver and emulation
@@ -396,6 +536,15 @@ bool ConsolePlayer::createSidEmu(SIDEMUS emu, const SidTuneInfo *tuneInfo) {
 #endif
 	);
 
+	m_engCfg.sidEmulation = createBuilder(emu, is6581, m_engine.info().maxsids());
+
+	return m_engCfg.sidEmulation || (emu <= EMU_DEFAULT);
+}
+
+// Create a SID builder set up with the user's filter settings
+sidbuilder* ConsolePlayer::createBuilder(SIDEMUS emu, bool is6581, unsigned int maxsids) {
+	sidbuilder *builder = nullptr;
+
 	// Now set it up
 	switch (emu) {
 #ifdef HAVE_SIDPLAYFP_BUILDERS_RESIDFP_H
@@ -404,12 +553,12 @@ bool ConsolePlayer::createSidEmu(SIDEMUS emu, const SidTuneInfo *tuneInfo) {
 		try {
 			ReSIDfpBuilder *rs = new ReSIDfpBuilder(RESIDFP_ID);
 
-			m_engCfg.sidEmulation = rs;
+			builder = rs;
 
 #ifndef FEAT_NO_CREATE
-			if (!rs->getStatus()) goto createSidEmu_error;
-			rs->create(m_engine.info().maxsids());
-			if (!rs->getStatus()) goto createSidEmu_error;
+			if (!rs->getStatus()) goto createBuilder_error;
+			rs->create(maxsids);
+			if (!rs->getStatus()) goto createBuilder_error;
 #endif
 
 #ifdef FEAT_CW_STRENGTH
@@ -477,7 +626,7 @@ bool ConsolePlayer::createSidEmu(SIDEMUS emu, const SidTuneInfo *tuneInfo) {
 		try {
 			ReSIDfpIIBuilder *rs = new ReSIDfpIIBuilder(RESIDFPII_ID);
 
-			m_engCfg.sidEmulation = rs;
+			builder = rs;
 			rs->combinedWaveformsStrength(m_combinedWaveformsStrength);
 
 			if (is6581) {
@@ -530,10 +679,10 @@ bool ConsolePlayer::createSidEmu(SIDEMUS emu, const SidTuneInfo *tuneInfo) {
 		try {
 			ReSIDBuilder *rs = new ReSIDBuilder(RESID_ID);
 
-			m_engCfg.sidEmulation = rs;
-			if (!rs->getStatus()) goto createSidEmu_error;
-			rs->create(m_engine.info().maxsids());
-			if (!rs->getStatus()) goto createSidEmu_error;
+			builder = rs;
+			if (!rs->getStatus()) goto createBuilder_error;
+			rs->create(maxsids);
+			if (!rs->getStatus()) goto createBuilder_error;
 
 			rs->bias(m_filter.bias);
 		}
@@ -550,29 +699,133 @@ bool ConsolePlayer::createSidEmu(SIDEMUS emu, const SidTuneInfo *tuneInfo) {
 		break;
 	}
 
-	if (!m_engCfg.sidEmulation) {
+	if (!builder) {
 		if (emu > EMU_DEFAULT) { // No SID emulation?
 			displayError("ERROR: not enough memory!");
-			return false;
 		}
+
+		return nullptr;
 	}
 
 #ifndef FEAT_FILTER_DISABLE
-	if (m_engCfg.sidEmulation) { // set the SID filter up
-		m_engCfg.sidEmulation->filter(m_filter.enabled);
-	}
+	builder->filter(m_filter.enabled); // set the SID filter up
 #endif
 
-	return true;
+	return builder;
 
 #ifndef FEAT_NO_CREATE
-createSidEmu_error:
-	displayError(m_engCfg.sidEmulation->error());
-	delete m_engCfg.sidEmulation;
-	m_engCfg.sidEmulation = nullptr;
+createBuilder_error:
+	displayError(builder->error());
+	delete builder;
 
-	return false;
+	return nullptr;
+#endif
+}
+
+// Analysis runs on engines of its own, which need the ROMs too
+void ConsolePlayer::setAnalyzerRoms(Analyzer &analyzer) {
+	std::unique_ptr<uint8_t[]> kernalRom  = loadRom(m_iniCfg.playercfg().kernalRom, 8192, "kernal");
+	std::unique_ptr<uint8_t[]> basicRom	  = loadRom(m_iniCfg.playercfg().basicRom, 8192, "basic");
+	std::unique_ptr<uint8_t[]> chargenRom = loadRom(m_iniCfg.playercfg().chargenRom, 4096, "chargen");
+
+	analyzer.setRoms(kernalRom.get(), basicRom.get(), chargenRom.get());
+}
+
+// Find the song lengths or the loudness of every file given, in parallel
+bool ConsolePlayer::analyze(void) {
+	Analyzer::builder_factory_t factory;
+
+	// Without SID emulation only loops can end a tune
+	if (m_driver.sid != EMU_NONE) {
+		factory = [this](bool is6581) {
+			return createBuilder(m_driver.sid, is6581, m_engine.info().maxsids());
+		};
+	}
+#ifdef FEAT_NEW_PLAY_API
+	else if (m_analysis.loudness) {
+		displayError("ERROR: can't measure loudness without SID emulation!");
+		return false;
+	}
+#else
+	else {
+		displayError("ERROR: can't find song lengths without SID emulation!");
+		return false;
+	}
 #endif
+
+	Analyzer analyzer(m_engCfg, factory);
+
+	setAnalyzerRoms(analyzer);
+	analyzer.setFilter(m_filter.enabled);
+	analyzer.setMode(m_analysis.loudness ? Analyzer::LOUDNESS : Analyzer::SONGLENGTHS);
+
+	// -l sets the longest length to search
+	analyzer.setLimits(
+		(m_timer.valid && m_timer.length) ? m_timer.length : Analyzer::MAX_LENGTH,
+		Analyzer::SILENCE
+	);
+
+	const char* hvscBase = getenv("HVSC_BASE");
+	SidDatabase *known	 = songlengthDB ? &m_database : nullptr;
+
+	for (const std::string &file : m_analysis.files) {
+		if (analyzer.add(file, known))
+			continue;
+
+		// Try prepending HVSC_BASE
+		if (hvscBase && analyzer.add(std::string(hvscBase).append(SEPARATOR).append(file), known))
+			continue;
+
+		cerr << m_name << ": " << file << ": not a SID tune, skipped" << endl;
+	}
+
+	analyzer.run();
+
+	const auto write = [this, &analyzer](std::ostream &out, bool header) {
+		if (m_analysis.loudness)
+			analyzer.writeLoudness(out, header);
+		else
+			analyzer.writeSonglengths(out, header);
+	};
+
+	if (m_analysis.output.empty()) {
+		write(std::cout, true);
+		return true;
+	}
+
+	std::ofstream out(m_analysis.output, std::ios::app);
+	if (out.is_open()) {
+		out.seekp(0, std::ios::end);
+		write(out, out.tellp() == 0);
+	}
+
+	if (!out) {
+		displayError("ERROR: could not write the analysis results!");
+		return false;
+	}
+
+	return true;
+}
+
+// Look for the loop of the selected subtune without SID emulation
+bool ConsolePlayer::findLoop(void) {
+	Analyzer analyzer(m_engCfg);
+
+	setAnalyzerRoms(analyzer);
+
+	return analyzer.findLoop(m_filename, m_track.selected, m_loop.points);
+}
+
+// Length of the loop that was found, in samples at the output's
+// rate. Without one, loop mode goes around the whole render.
+uint_least64_t ConsolePlayer::loopSamples() const {
+	if (!m_loop.seamless)
+		return m_cache.length();
+
+	const uint_least64_t frames = std::llround(
+		m_loop.points.length * m_driver.cfg.sampleRate / m_loop.points.clock);
+
+	return frames * m_driver.cfg.channels;
 }
 
 bool ConsolePlayer::open(void) {
@@ -596,14 +849,24 @@ bool ConsolePlayer::open(void) {
 	if (!m_track.single)
 		m_track.songs = tuneInfo->songs();
 
-	if (!createOutput(m_driver.output, tuneInfo))
-		return false;
+	// An album keeps its one output through all the subtunes
+	if (!m_album.enabled || !m_album.cue.tracks()) {
+		if (!createOutput(m_driver.output, tuneInfo))
+			return false;
+	}
 
 	if (!createSidEmu(m_driver.sid, tuneInfo))
 		return false;
 
-	// Configure engine with settings
-	if (!m_engine.config(m_engCfg)) { // Config failed?
+	// Configure engine with settings, at a rate of its own
+	// if it has one
+	SidConfig engCfg = m_engCfg;
+#ifdef FEAT_NEW_PLAY_API
+	if (m_engineRate)
+		engCfg.frequency = m_engineRate;
+#endif
+
+	if (!m_engine.config(engCfg)) { // Config failed?
 		displayError(m_engine.error());
 
 		return false;
@@ -625,7 +888,23 @@ bool ConsolePlayer::open(void) {
 	) ? freqTableNtsc : freqTablePal;
 
 #ifdef FEAT_NEW_PLAY_API
-	m_mixer.initialize(m_engine.installedSIDs(),m_engCfg.playback == SidConfig::STEREO);
+	m_resampler.initialize(engCfg.frequency, m_driver.cfg.sampleRate, m_driver.cfg.channels);
+
+	{
+		// Floats get the 24 bits, and so does the resampler
+		unsigned int bits = 16;
+		switch (m_driver.samples) {
+		case SAMPLES_S24:
+		case SAMPLES_FLOAT: bits = 24; break;
+		case SAMPLES_S32:	bits = 32; break;
+		default: break;
+		}
+
+		if (m_resampler.active())
+			bits = 24;
+
+		m_mixer.initialize(m_engine.installedSIDs(), m_engCfg.playback == SidConfig::STEREO, bits);
+	}
 #endif
 
 	// Start the player. Do this by fast
@@ -633,6 +912,7 @@ bool ConsolePlayer::open(void) {
 	m_driver.selected = &m_driver.null;
 #ifdef FEAT_NEW_PLAY_API
 	m_mixer.clear();
+	m_resampler.reset();
 	m_mixer.setFastForward(m_speed.current);
 	m_mixer.setVolume(Mixer::VOLUME_MAX);
 #else
@@ -656,8 +936,11 @@ bool ConsolePlayer::open(void) {
 #endif
 
 	// As yet we don't have a required songlength
-	// so try the songlength database or keep the default
+	// so try the songlength database or keep the default,
+	// not whatever the last subtune got
 	if (!m_timer.valid) {
+		m_timer.length = m_timer.defaultLength;
+
 		int_least32_t length = m_database.lengthMs(m_tune);
 
 		if (length > 0) {
@@ -675,6 +958,22 @@ bool ConsolePlayer::open(void) {
 		}
 	}
 
+	// Exact loop points beat the database, the tune lasts
+	// one pass through its intro and its loop. Loop mode can
+	// then go around the loop from memory without a seam.
+	m_loop.seamless = false;
+	if (m_loop.find && !m_timer.valid) {
+		if (m_loop.song != m_track.selected) {
+			m_loop.song  = m_track.selected;
+			m_loop.found = findLoop();
+		}
+
+		if (m_loop.found) {
+			m_timer.length	= m_loop.points.endMs();
+			m_loop.seamless = m_track.loop && (m_speed.current == 1) && !m_cpudebug;
+		}
+	}
+
 	// Set up the play timer, also account for the fade out time
 	m_timer.stop = m_timer.length;
 
@@ -684,7 +983,8 @@ bool ConsolePlayer::open(void) {
 	if (m_timer.length == 0)
 		m_fadeoutLen = 0;
 	
-	m_timer.stop += m_fadeoutLen;
+	if (!m_loop.seamless)
+		m_timer.stop += m_fadeoutLen;
 #endif
 
 	if (m_timer.valid) { // Length relative to start
@@ -697,10 +997,69 @@ bool ConsolePlayer::open(void) {
 		}
 	}
 
+	// The subtune starts a new track of the album, and
+	// a file of its own when splitting
+	if (m_album.enabled) {
+		if (!m_album.cue.tracks() && (tuneInfo->numberOfInfoStrings() == 3))
+			m_album.cue.setInfo(tuneInfo->infoString(0), tuneInfo->infoString(1));
+
+		std::ostringstream title;
+		title << "Subtune " << m_track.selected;
+		m_album.cue.addTrack(title.str(), m_album.frames);
+
+		if (m_album.split) {
+			delete m_album.part;
+			m_album.part = nullptr;
+
+			try {
+				m_album.part = createFile(m_driver.output, tuneInfo, true);
+			}
+			catch (std::bad_alloc const &ba) {
+				displayError("ERROR: not enough memory!");
+				return false;
+			}
+
+			// Same format as the album, samples are copied as they are
+			AudioConfig cfg = m_driver.cfg;
+			if (!m_album.part->open(cfg)) {
+				displayError(m_album.part->getErrorString());
+				return false;
+			}
+		}
+	}
+
+	// A render of known length can be laid out on disk up front,
+	// which only a subtune's own file can be when making an album
+	if ((m_driver.output == OUT_WAV) && m_timer.stop && !m_track.loop) {
+		IAudio* const wav = m_album.enabled ? m_album.part
+			: m_driver.monitor ? static_cast<Audio_Tee*>(m_driver.device)->recorder()
+			: m_driver.device;
+		if (wav)
+			static_cast<WavFile*>(wav)->setLength(m_timer.stop - m_timer.start);
+	}
+
 	m_timer.current  = ~0;
 	m_timer.starting = true;
 	m_state = playerRunning;
 
+	// Serve the tune from the render cache if we've been here
+	// before, otherwise record it. Loops are kept in memory so
+	// that only the first pass gets emulated. Only finite renders
+	// at normal speed can be cached.
+	if ((m_driver.cache || m_track.loop) && m_timer.stop && (m_driver.samples == SAMPLES_S16)
+			&& (m_speed.current == 1) && !m_bench.enabled && !m_cpudebug) {
+		const bool cached = m_cache.open(cacheKey(tuneInfo), m_driver.cache, m_track.loop);
+
+		// Pick up where the first pass ended and keep going
+		// around the loop instead of restarting the tune
+		if (cached && m_track.loop && m_cache.loop(loopSamples()))
+			m_timer.stop = 0;
+	}
+	else
+		m_cache.close();
+
+	benchReset();
+
 	// Update display
 	menu();
 	updateDisplay();
@@ -708,6 +1067,50 @@ bool ConsolePlayer::open(void) {
 	return true;
 }
 
+// Describe everything that affects the rendered sound
+std::string ConsolePlayer::cacheKey(const SidTuneInfo *tuneInfo) {
+	std::ostringstream key;
+
+	key << "C64play " VERSION ";" << m_engine.info().name()
+		<< ' ' << m_engine.info().version()
+		<< ";md5=" << m_tune.createMD5New()
+		<< ";song=" << tuneInfo->currentSong()
+		<< ";engine=" << (m_engCfg.sidEmulation ?
+			m_engCfg.sidEmulation->name() : "none")
+		<< ";freq=" << m_engCfg.frequency
+		<< (m_engineRate ? ";engine_freq=" + std::to_string(m_engineRate) : std::string())
+		<< ";playback=" << m_engCfg.playback
+		<< ";c64=" << m_engCfg.defaultC64Model << ',' << m_engCfg.forceC64Model
+		<< ";sid=" << m_engCfg.defaultSidModel << ',' << m_engCfg.forceSidModel
+		<< ";cia=" << m_engCfg.ciaModel
+		<< ";digiboost=" << m_engCfg.digiBoost
+		<< ";sids=" << m_engCfg.secondSidAddress << ',' << m_engCfg.thirdSidAddress
+		<< ";delay=" << m_engCfg.powerOnDelay
+		<< ";sampling=" << m_engCfg.samplingMethod
+#ifdef HAVE_SIDPLAYFP_BUILDERS_RESID_H
+		<< ',' << m_engCfg.fastSampling
+		<< ";bias=" << m_filter.bias
+#endif
+		<< ";filter=" << m_filter.enabled
+		<< ";curve=" << m_filter.filterCurve6581 << ',' << m_filter.filterCurve8580
+#ifdef FEAT_FILTER_RANGE
+		<< ";range=" << m_filter.filterRange6581
+#endif
+#ifdef FEAT_CW_STRENGTH
+		<< ";cw=" << m_combinedWaveformsStrength
+#endif
+		<< ";mute=" << m_mute_channel.to_string()
+#ifdef FEAT_SAMPLE_MUTE
+		<< ',' << m_mute_samples.to_string()
+#endif
+#ifdef FEAT_NEW_PLAY_API
+		<< ";fade=" << m_fadeoutLen
+#endif
+		<< ";time=" << m_timer.start << '-' << m_timer.stop;
+
+	return key.str();
+}
+
 void ConsolePlayer::close() {
 #ifndef FEAT_NEW_PLAY_API
 	m_engine.stop();
@@ -718,6 +1121,27 @@ void ConsolePlayer::close() {
 	} else // Destroy buffers
 		m_driver.selected->reset();
 
+	m_cache.close();
+
+	// Finish the album, and list where its subtunes start
+	if (m_album.enabled) {
+		delete m_album.part;
+		m_album.part = nullptr;
+
+		if (m_album.cue.tracks() && (m_album.name.compare("-") != 0)) {
+			const std::string cue = stripExtension(m_album.name) + ".cue";
+
+			const size_t slash = m_album.name.find_last_of(SEPARATOR[0]);
+			const std::string file = (slash == std::string::npos)
+				? m_album.name : m_album.name.substr(slash + 1);
+
+			if (!m_album.cue.write(cue, file, (m_driver.output == OUT_RAW) ? "BINARY" : "WAVE",
+								   m_driver.cfg.sampleRate))
+				displayError("WARNING: could not write the cue sheet!");
+		}
+		m_album.cue.clear();
+	}
+
 	// Shutdown drivers, etc
 	createOutput   (OUT_NULL, nullptr);
 	createSidEmu   (EMU_NONE, nullptr);
@@ -742,11 +1166,14 @@ bool ConsolePlayer::play() {
 	uint_least32_t retSize = 0;
 
 	if (m_state == playerRunning) LIKELY {
+		if (!waitOutput())
+			return true;
+
 		updateDisplay();
 
 #ifdef FEAT_NEW_PLAY_API
         // fade the tune out!
-		if (m_fadeoutLen && (m_timer.stop > m_fadeoutLen)) UNLIKELY {
+		if (m_fadeoutLen && !m_loop.seamless && (m_timer.stop > m_fadeoutLen)) UNLIKELY {
 			const uint_least32_t timeleft = m_timer.stop - m_timer.current;
 
 			if (timeleft <= m_fadeoutLen) {
@@ -760,47 +1187,47 @@ bool ConsolePlayer::play() {
 		const  uint_least32_t length = getBufSize();
 		short* buffer = m_driver.selected->buffer(); // Fill buffer
 
-#ifdef FEAT_NEW_PLAY_API
-		m_mixer.begin(buffer, length);
-		short* buffers[3];
-		m_engine.buffers(buffers);
-
-		do {
-			// play for 2K cycles first
-			int samples = m_engine.play(2000);
-			
-			if (samples < 0) UNLIKELY { // exit on error
-				cerr << m_engine.error();
-				m_state = playerError;
-
-				return false;
-			}
-			// in case we have `-b` set, don't play
-			// until we reach the specified timestamp
-			else if (!buffer) UNLIKELY
-				break;
-			else if (samples > 0)
-				m_mixer.doMix(buffers, samples);
-			else break;
-		} while (!m_mixer.isFull());
+		if (m_cache.replaying()) UNLIKELY {
+			// Rendered before, leave the emulation idle
+			if (buffer)
+				m_cache.read(buffer, length);
+		}
+		else if (!render(buffer, length)) UNLIKELY
+			return false;
 
 		retSize = length;
-#else
-		retSize = m_engine.play(buffer, length);
-
-		if ((retSize < length) || !m_engine.isPlaying()) UNLIKELY {
-			cerr << m_engine.error();
-			m_state = playerError;
-
-			return false;
-		}
-#endif
 	}
 	else if (m_state == playerPaused)
 		usleep(100000);
 
 	switch (m_state) {
 	LIKELY case playerRunning:
+	{
+		// Hash the samples before the driver gets to touch them
+		if (m_bench.enabled && !m_timer.starting) UNLIKELY
+			benchHash(m_driver.selected->buffer(), retSize);
+
+		if (m_cache.capturing() && !m_timer.starting)
+			m_cache.write(m_driver.selected->buffer(), retSize);
+
+		// The subtune's own file gets a copy first, the
+		// album's buffer is gone once it's been written
+		if (m_album.part && !m_timer.starting) {
+			std::memcpy(m_album.part->buffer(), m_driver.selected->buffer(),
+						retSize * ((m_driver.samples == SAMPLES_S16) ? 2 : 4));
+
+			if (!m_album.part->write(retSize)) UNLIKELY {
+				cerr << m_album.part->getErrorString();
+				m_state = playerError;
+
+				return false;
+			}
+		}
+
+		bench_clock::time_point t0;
+		if (m_bench.enabled) UNLIKELY
+			t0 = bench_clock::now();
+
 		if (!m_driver.selected->write(retSize)) UNLIKELY {
 			cerr << m_driver.selected->getErrorString();
 			m_state = playerError;
@@ -808,6 +1235,15 @@ bool ConsolePlayer::play() {
 			return false;
 		}
 
+		if (m_bench.enabled) UNLIKELY {
+			m_bench.output += bench_clock::now() - t0;
+			if (!m_timer.starting)
+				m_bench.samples += retSize / m_driver.cfg.channels;
+		}
+		if (!m_timer.starting)
+			m_album.frames += retSize / m_driver.cfg.channels;
+	}
+
 	case playerPaused: // fall-through
 		// Check for a keypress (rate depends on buffer size).
 		// Don't do this for high quiet levels as chances are
@@ -827,6 +1263,16 @@ bool ConsolePlayer::play() {
 		if (m_quietLevel < 3)
 			cerr << '\n';
 
+		if (m_bench.enabled && (m_state != playerError))
+			benchReport();
+
+		if (m_driver.stats)
+			statsReport();
+
+		// Played all the way through, keep it for next time
+		if ((m_state == playerExit) || (m_state == playerRestart))
+			m_cache.commit();
+
 #ifndef FEAT_NEW_PLAY_API
 		m_engine.stop();
 #endif
@@ -837,6 +1283,102 @@ bool ConsolePlayer::play() {
 }
 
 
+// Run the emulation until the buffer is full
+bool ConsolePlayer::render(short *buffer, uint_least32_t length) {
+#ifdef FEAT_NEW_PLAY_API
+	// Mix at the engine's rate for the resampler, which
+	// takes it to the output's
+	const bool resampling = buffer && m_resampler.active();
+	const uint_least32_t frames = length / m_driver.cfg.channels;
+	uint_least32_t needed = 0;
+
+	if (resampling) {
+		needed = m_resampler.needed(frames);
+		m_resampleBuffer.resize(needed * m_driver.cfg.channels);
+		m_mixer.begin(m_resampleBuffer.data(), needed * m_driver.cfg.channels);
+	} else {
+		// Wider drivers hand out 32-bit samples
+		switch (m_driver.samples) {
+		case SAMPLES_S24:
+		case SAMPLES_S32:
+			m_mixer.begin(reinterpret_cast<int_least32_t*>(buffer), length);
+			break;
+		case SAMPLES_FLOAT:
+			m_mixer.begin(reinterpret_cast<float*>(buffer), length);
+			break;
+		default:
+			m_mixer.begin(buffer, length);
+			break;
+		}
+	}
+	short* buffers[3];
+	m_engine.buffers(buffers);
+
+	do {
+		// play for 2K cycles first, timed only for benchmarks
+		bench_clock::time_point t0, t1;
+		if (m_bench.enabled) UNLIKELY
+			t0 = bench_clock::now();
+
+		int samples = m_engine.play(2000);
+
+		if (m_bench.enabled) UNLIKELY {
+			t1 = bench_clock::now();
+			m_bench.emulation += t1 - t0;
+			m_bench.cycles    += 2000;
+		}
+
+		if (samples < 0) UNLIKELY { // exit on error
+			cerr << m_engine.error();
+			m_state = playerError;
+
+			return false;
+		}
+		// in case we have `-b` set, don't play
+		// until we reach the specified timestamp
+		else if (!buffer) UNLIKELY
+			break;
+		else if (samples > 0) {
+			m_mixer.doMix(buffers, samples);
+			if (m_bench.enabled) UNLIKELY
+				m_bench.mixing += bench_clock::now() - t1;
+		}
+		else break;
+	} while (!m_mixer.isFull());
+
+	if (resampling) {
+		m_resampler.push(m_resampleBuffer.data(), needed);
+
+		switch (m_driver.samples) {
+		case SAMPLES_S24:
+			m_resampler.pull(reinterpret_cast<int_least32_t*>(buffer), frames, 24);
+			break;
+		case SAMPLES_S32:
+			m_resampler.pull(reinterpret_cast<int_least32_t*>(buffer), frames, 32);
+			break;
+		case SAMPLES_FLOAT:
+			m_resampler.pull(reinterpret_cast<float*>(buffer), frames);
+			break;
+		default:
+			m_resampler.pull(buffer, frames);
+			break;
+		}
+	}
+#else
+	const uint_least32_t retSize = m_engine.play(buffer, length);
+
+	if ((retSize < length) || !m_engine.isPlaying()) UNLIKELY {
+		cerr << m_engine.error();
+		m_state = playerError;
+
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+
 void ConsolePlayer::stop() {
 	m_state = playerStopped;
 #ifndef FEAT_NEW_PLAY_API
@@ -860,6 +1402,7 @@ uint_least32_t ConsolePlayer::getBufSize() {
 		memset(m_driver.selected->buffer(), 0, m_driver.cfg.bufSize);
 #ifdef FEAT_NEW_PLAY_API
 		m_mixer.clear();
+		m_resampler.reset();
 		m_mixer.setFastForward(1);
 #else
 		m_engine.fastForward(100);
@@ -869,6 +1412,13 @@ uint_least32_t ConsolePlayer::getBufSize() {
 			m_engine.debug(true, nullptr);
 	}
 	else if ((m_timer.stop != 0) && (m_timer.current >= m_timer.stop)) UNLIKELY {
+		// The first pass is in memory now, go around its loop
+		// from there without letting go of the sound card
+		if (m_track.loop && m_cache.commitLoop(loopSamples())) {
+			m_timer.stop = 0;
+			return m_driver.cfg.bufSize;
+		}
+
 		m_state = playerExit;
 
 		if (m_track.loop) { m_state = playerRestart; }
@@ -896,8 +1446,41 @@ uint_least32_t ConsolePlayer::getBufSize() {
 }
 
 
+// Sleep until the sound card has room for a buffer, or a key is
+// pressed, rather than inside write(). False when play() has to
+// look at the state again before going on.
+bool ConsolePlayer::waitOutput() {
+	constexpr int MAX_FDS = 16;
+
+	struct pollfd fds[MAX_FDS];
+	const int count = m_driver.selected->pollDescriptors(fds + 1, MAX_FDS - 1);
+	if (count <= 0)
+		return true;
+
+	// poll() skips negative descriptors
+	fds[0].fd	  = (m_quietLevel < 3) ? keyboard_fd() : -1;
+	fds[0].events = POLLIN;
+
+	const int ret = poll(fds, count + 1, 1000);
+	if (ret < 0)
+		return errno != EINTR; // a signal may have stopped us
+	if (ret == 0)
+		return true; // stuck, let write() find out why
+
+	if (fds[0].revents & POLLIN) {
+		decodeKeys();
+		return false;
+	}
+
+	return m_driver.selected->ready(fds + 1, count);
+}
+
 void ConsolePlayer::updateDisplay() {
-	const uint_least32_t milliseconds = m_engine.timeMs();
+	// The engine's clock stands still while replaying from the cache
+	const uint_least32_t milliseconds = m_cache.replaying() ?
+		m_timer.start + m_cache.position() * 1000 /
+			(m_driver.cfg.sampleRate * m_driver.cfg.channels)
+		: m_engine.timeMs();
 	const uint_least32_t seconds = milliseconds / 1000;
 
 	if (!m_quietLevel) {
@@ -905,30 +1488,84 @@ void ConsolePlayer::updateDisplay() {
 			refreshRegDump();
 
 		if (seconds != (m_timer.current / 1000)) {
-			cerr << std::setw(2) << std::setfill('0')
+			std::ostringstream time;
+			time << std::setw(2) << std::setfill('0')
 				 << ((seconds / 60) % 100) << ':' << std::setw(2)
-				 << std::setfill('0') << (seconds % 60) << std::flush;
+				 << std::setfill('0') << (seconds % 60);
+
+			if (m_driver.stats) {
+				const AudioStats stats = m_driver.selected->stats();
+				time << "  xruns: " << stats.underruns
+					 << ", delay: " << std::setw(4) << std::setfill(' ')
+					 << (static_cast<uint_least64_t>(stats.delay) * 1000 / m_driver.cfg.sampleRate)
+					 << " ms";
+			}
+
+			cerr << time.str() << std::flush;
 
 			// this hack has to be done because for some
 			// reason at both level 1 and 0 it appends to
 			// the timer instead of overwriting it
 			if (m_verboseLevel <= 1)
-				cerr << "\b\b\b\b\b";
+				cerr << std::string(time.str().size(), '\b');
 		}
 	}
 
 	m_timer.current = milliseconds;
 }
 
+// Same shape as the benchmark report, but goes to stderr when
+// the audio itself is being written to stdout
+void ConsolePlayer::statsReport() {
+	const AudioStats stats = m_driver.selected->stats();
+	const double rate = m_driver.cfg.sampleRate;
+
+	std::ostream &out = ((m_outfile != nullptr) && (std::strcmp(m_outfile, "-") == 0)) ?
+		cerr : std::cout;
+
+	out << std::fixed << std::setprecision(3)
+		<< "{\"subtune\":" << m_tune.getInfo()->currentSong()
+		<< ",\"frames\":" << stats.frames
+		<< ",\"underruns\":" << stats.underruns
+		<< ",\"delay_ms\":" << (stats.delay * 1000. / rate)
+		<< ",\"blocked_ms\":" << (stats.blocked / 1000.)
+		<< "}" << endl;
+}
+
 void ConsolePlayer::displayError(const char *error) {
 	cerr << m_name << ": " << error << endl;
 }
 
+// Whether a key changes what the tune sounds like
+static bool changesOutput(int action) {
+	switch (action) {
+	case A_UP_ARROW:
+	case A_DOWN_ARROW:
+	case A_INCREASE:
+	case A_DECREASE:
+	case A_RESTORE:
+		return true;
+	default:
+		return (action >= A_TOGGLE_VOICE1) && (action <= A_TOGGLE_FILTER);
+	}
+}
+
 // Keyboard handling
 void ConsolePlayer::decodeKeys() {
 	while (_kbhit()) {
 		const int action = keyboard_decode();
 
+		// Those can't be applied to a render coming from the
+		// cache, so start the subtune over under emulation with
+		// the change in place. They also spoil any recording.
+		if (changesOutput(action)) {
+			if (m_cache.replaying())
+				m_state = playerFastRestart;
+
+			m_cache.close();
+			m_cache.forget();
+		}
+
 		switch (action) {
 		case A_INVALID:
 			continue;
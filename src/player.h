@@ -28,8 +28,10 @@
 #endif
 
 #include <string>
+#include <vector>
 #include <bitset>
 #include <optional>
+#include <chrono>
 
 #include <sidplayfp/SidTune.h>
 #include <sidplayfp/sidplayfp.h>
@@ -41,9 +43,13 @@
 #include "audio/AudioConfig.h"
 #include "audio/null/null.h"
 #include "IniConfig.h"
+#include "cache.h"
+#include "cuesheet.h"
+#include "analyzer.h"
 
 #ifdef FEAT_NEW_PLAY_API
 # include <mixer.h>
+# include <resampler.h>
 #endif
 
 #include "sidlib_features.h"
@@ -52,6 +58,8 @@
 template <typename T>
 using Setting = std::optional<T>;
 
+using bench_clock = std::chrono::steady_clock;
+
 typedef enum {
     playerError = 0,
 	playerRunning,
@@ -78,11 +86,22 @@ typedef enum {
 
 typedef enum {
 	OUT_NULL,
+	OUT_SIM,      // simulated sound card
 	OUT_SOUNDCARD,
 	OUT_WAV,
+	OUT_FLAC,
+	OUT_RAW,
 	OUT_END
 } OUTPUTS;
 
+// What the mixer puts in the output's buffer
+typedef enum {
+	SAMPLES_S16,
+	SAMPLES_S24,  // in 32-bit words
+	SAMPLES_S32,
+	SAMPLES_FLOAT
+} SAMPLES;
+
 class Chip {
 	public:
 	enum type {
@@ -116,6 +135,7 @@ private:
 
     IniConfig       m_iniCfg;
     SidDatabase     m_database;
+    LoudnessDatabase m_loudness;
 
     Setting<double> m_fcurve;
 
@@ -146,9 +166,14 @@ private:
 
     uint_least8_t   m_channels;
     uint_least8_t   m_bitDepth;
+    uint_least32_t  m_engineRate; // 0 to run at the output's
 
 #ifdef FEAT_NEW_PLAY_API
 	Mixer m_mixer;
+
+	// From the engine's rate to the output's
+	Resampler          m_resampler;
+	std::vector<float> m_resampleBuffer;
 #endif
 
     struct m_filter_t {
@@ -171,8 +196,17 @@ private:
         OUTPUTS     output;   // Selected output type
         SIDEMUS     sid;      // SID emulation
         bool        file;     // File based driver
+        bool        monitor;  // Play the file on the sound card too
+        bool        splice;   // vmsplice() raw samples into a pipe
         bool        info;     // File metadata
+        bool        cache;    // Use the render cache
+        uint32_t    bufferTime; // Requested device latency (us)
+        uint32_t    periodTime;
+        bool        lowLatency;
+        uint32_t    jitter;   // How late simulated periods get (us)
+        bool        stats;    // Show and report output statistics
         AudioConfig cfg;
+        SAMPLES     samples;
         IAudio*     selected; // Selected Output Driver
         IAudio*     device;   // Sound card/File Driver
         Audio_Null  null;     // Used for everything
@@ -183,6 +217,7 @@ private:
 		uint_least32_t current;
         uint_least32_t stop;
         uint_least32_t length;
+        uint_least32_t defaultLength; // without database or loop
         bool           valid;
         bool           starting;
     } m_timer;
@@ -199,11 +234,49 @@ private:
         bool     single;
     } m_track;
 
+    RenderCache     m_cache;
+
     struct m_speed_t {
         uint8_t current;
         uint8_t max;
     } m_speed;
 
+    struct m_bench_t {
+        bool                  enabled;
+        bool                  fingerprint; // go through every subtune
+        uint_least64_t        hash;      // of the rendered PCM
+        uint_least64_t        cycles;    // emulated CPU cycles
+        uint_least64_t        samples;   // output frames
+        bench_clock::duration emulation; // time spent in each stage
+        bench_clock::duration mixing;
+        bench_clock::duration output;
+        bench_clock::time_point started;
+    } m_bench;
+
+    struct m_loop_t {
+        bool             find;     // look for exact loop points
+        bool             found;
+        bool             seamless; // loop mode goes around from memory
+        uint16_t         song;     // subtune the points belong to
+        Analyzer::loop_t points;
+    } m_loop;
+
+    struct m_album_t {
+        bool           enabled;  // every subtune into one file
+        bool           split;    // and each into a file of its own
+        uint_least64_t frames;   // written to the album so far
+        std::string    name;     // of the album file
+        IAudio*        part;     // the current subtune's own file
+        CueSheet       cue;
+    } m_album;
+
+    struct m_analysis_t {
+        bool                     enabled;
+        bool                     loudness; // instead of song lengths
+        std::string              output;   // database to append to
+        std::vector<std::string> files;
+    } m_analysis;
+
 private:
     // Console
     void consoleColor  (color_t color);
@@ -214,17 +287,34 @@ private:
     void displayArgs   (const char *arg = nullptr);
 
     bool createOutput  (OUTPUTS driver, const SidTuneInfo *tuneInfo);
+    IAudio* createFile (OUTPUTS driver, const SidTuneInfo *tuneInfo, bool subtune);
     bool createSidEmu  (SIDEMUS emu, const SidTuneInfo *tuneInfo);
+    sidbuilder* createBuilder(SIDEMUS emu, bool is6581, unsigned int maxsids);
+    void setAnalyzerRoms(Analyzer &analyzer);
+    bool findLoop      (void);
+    uint_least64_t loopSamples() const;
     void decodeKeys    (void);
     void updateDisplay (void);
+    bool waitOutput    (void);
     void menu          (void);
     void refreshRegDump(void);
 
     uint_least32_t getBufSize();
+    bool render(short *buffer, uint_least32_t length);
+
+    std::string cacheKey(const SidTuneInfo *tuneInfo);
+
+    // Throughput measurement
+    void benchReset (void);
+    void benchHash  (const short *buffer, uint_least32_t size);
+    void benchReport(void);
+
+    // Output statistics, as a JSON line per subtune
+    void statsReport(void);
 
 	std::string getNote(uint16_t freq);
 
-    std::string getFileName(const SidTuneInfo *tuneInfo, const char* ext);
+    std::string getFileName(const SidTuneInfo *tuneInfo, const char* ext, bool subtune = false);
 
     inline bool tryOpenTune(const char *hvscBase);
     inline bool tryOpenDatabase(const char *hvscBase);
@@ -241,6 +331,10 @@ public:
     bool play (void);
     void stop (void);
 
+    // Find the song lengths of the files given instead of playing
+    bool analyzing(void) const { return m_analysis.enabled; }
+    bool analyze  (void);
+
     player_state_t state(void) const { return m_state; }
 };
 
@@ -0,0 +1,219 @@
+/*
+ * This file is part of C64play, a console SID tune player.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE__
+#  include <xmmintrin.h>
+#endif
+
+namespace {
+
+// About 80 dB of stopband attenuation
+constexpr double KAISER_BETA = 8.;
+
+// Room for the transition band below the Nyquist frequency
+constexpr double PASSBAND = 0.92;
+
+constexpr unsigned int FRACTION_BITS = 32;
+constexpr unsigned int PHASE_BITS	 = 8; // log2(PHASES)
+
+// Zeroth order modified Bessel function of the first kind
+double besselI0(double x) {
+	double sum	= 1.;
+	double term = 1.;
+
+	for (int k = 1; term > sum * 1e-12; k++) {
+		const double t = x / (2. * k);
+		term *= t * t;
+		sum	 += term;
+	}
+
+	return sum;
+}
+
+}
+
+void Resampler::initialize(uint_least32_t inRate, uint_least32_t outRate, unsigned int channels) {
+	static_assert((1u << PHASE_BITS) == PHASES, "PHASE_BITS doesn't match PHASES");
+
+	m_active   = (inRate != outRate) && inRate && outRate;
+	m_channels = channels;
+
+	if (!m_active)
+		return;
+
+	m_step = (uint_least64_t) ((double) inRate / outRate * (1ull << FRACTION_BITS));
+
+	// In cycles per input sample
+	const double cutoff = 0.5 * PASSBAND * std::min(1., (double) outRate / inRate);
+	const double half	= TAPS / 2;
+	const double i0Beta = besselI0(KAISER_BETA);
+
+	m_table.resize((PHASES + 1) * TAPS);
+	for (unsigned int phase = 0; phase <= PHASES; phase++) {
+		float *row = &m_table[phase * TAPS];
+		double sum = 0.;
+
+		for (unsigned int k = 0; k < TAPS; k++) {
+			// Distance from the output sample, in input samples
+			const double t = (double) k - (half - 1.) - (double) phase / PHASES;
+			const double x = 2. * cutoff * t;
+			const double sinc = (x == 0.) ? 1. : std::sin(M_PI * x) / (M_PI * x);
+
+			const double w = t / half;
+			const double window = (std::fabs(w) < 1.) ?
+				besselI0(KAISER_BETA * std::sqrt(1. - w * w)) / i0Beta : 0.;
+
+			row[k] = sinc * window;
+			sum	  += row[k];
+		}
+
+		// Unity gain at DC for every phase
+		for (unsigned int k = 0; k < TAPS; k++)
+			row[k] /= sum;
+	}
+
+	reset();
+}
+
+void Resampler::reset() {
+	m_input.assign(m_channels, std::vector<float>());
+
+	// Silence before the first sample, so that the filter
+	// is centered on it right away
+	for (std::vector<float> &input : m_input)
+		input.assign(TAPS / 2 - 1, 0.f);
+
+	m_pos = 0;
+}
+
+uint_least32_t Resampler::needed(uint_least32_t frames) const {
+	if (!frames)
+		return 0;
+
+	const uint_least64_t last = (m_pos + (frames - 1) * m_step) >> FRACTION_BITS;
+	const uint_least64_t end  = last + TAPS;
+	const size_t		 have = m_input[0].size();
+
+	return (end > have) ? (uint_least32_t) (end - have) : 0;
+}
+
+void Resampler::push(const float *buffer, uint_least32_t frames) {
+	for (unsigned int c = 0; c < m_channels; c++) {
+		std::vector<float> &input = m_input[c];
+		const size_t start = input.size();
+
+		input.resize(start + frames);
+		for (uint_least32_t i = 0; i < frames; i++)
+			input[start + i] = buffer[i * m_channels + c];
+	}
+}
+
+// Blend the two rows on either side of the fraction
+void Resampler::setCoefficients(uint_least32_t fraction) {
+	const unsigned int phase = fraction >> (FRACTION_BITS - PHASE_BITS);
+	const float a = (fraction & ((1u << (FRACTION_BITS - PHASE_BITS)) - 1))
+		* (1.f / (1u << (FRACTION_BITS - PHASE_BITS)));
+
+	const float *row0 = &m_table[phase * TAPS];
+	const float *row1 = row0 + TAPS;
+
+#ifdef __SSE__
+	const __m128 blend = _mm_set1_ps(a);
+	for (unsigned int k = 0; k < TAPS; k += 4) {
+		const __m128 c0 = _mm_loadu_ps(row0 + k);
+		const __m128 c1 = _mm_loadu_ps(row1 + k);
+		_mm_store_ps(m_coefs + k, _mm_add_ps(c0, _mm_mul_ps(blend, _mm_sub_ps(c1, c0))));
+	}
+#else
+	for (unsigned int k = 0; k < TAPS; k++)
+		m_coefs[k] = row0[k] + a * (row1[k] - row0[k]);
+#endif
+}
+
+float Resampler::dot(const float *samples, const float *coefs) {
+#ifdef __SSE__
+	// Two sums, so that the adds don't wait on each other
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+
+	for (unsigned int k = 0; k < TAPS; k += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(samples + k), _mm_load_ps(coefs + k)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(samples + k + 4), _mm_load_ps(coefs + k + 4)));
+	}
+
+	alignas(16) float sums[4];
+	_mm_store_ps(sums, _mm_add_ps(sum0, sum1));
+	return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#else
+	float sum = 0.f;
+	for (unsigned int k = 0; k < TAPS; k++)
+		sum += samples[k] * coefs[k];
+	return sum;
+#endif
+}
+
+void Resampler::pull(float *buffer, uint_least32_t frames) {
+	for (uint_least32_t i = 0; i < frames; i++) {
+		const size_t start = m_pos >> FRACTION_BITS;
+		setCoefficients((uint_least32_t) m_pos);
+
+		for (unsigned int c = 0; c < m_channels; c++)
+			*buffer++ = dot(&m_input[c][start], m_coefs);
+
+		m_pos += m_step;
+	}
+
+	// Drop what's behind the filter now
+	const size_t used = m_pos >> FRACTION_BITS;
+	for (std::vector<float> &input : m_input)
+		input.erase(input.begin(), input.begin() + std::min(used, input.size()));
+
+	m_pos -= (uint_least64_t) used << FRACTION_BITS;
+}
+
+void Resampler::pull(short *buffer, uint_least32_t frames) {
+	const uint_least32_t samples = frames * m_channels;
+
+	m_output.resize(samples);
+	pull(m_output.data(), frames);
+
+	for (uint_least32_t i = 0; i < samples; i++) {
+		const float sample = std::clamp(m_output[i] * 32768.f, -32768.f, 32767.f);
+		buffer[i] = static_cast<short>(std::lrint(sample));
+	}
+}
+
+void Resampler::pull(int_least32_t *buffer, uint_least32_t frames, unsigned int bits) {
+	const uint_least32_t samples = frames * m_channels;
+	const double scale = (double) (1u << (bits - 1));
+
+	m_output.resize(samples);
+	pull(m_output.data(), frames);
+
+	for (uint_least32_t i = 0; i < samples; i++) {
+		const double sample = std::clamp(m_output[i] * scale, -scale, scale - 1.);
+		buffer[i] = static_cast<int_least32_t>(std::lrint(sample));
+	}
+}
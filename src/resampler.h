@@ -0,0 +1,89 @@
+/*
+ * This file is part of C64play, a console SID tune player.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Brings the mixer's output from the engine's sample rate to
+ * the device's.
+ *
+ * A polyphase windowed sinc filter: a table of TAPS long Kaiser
+ * windowed sincs for PHASES offsets between two input samples,
+ * with the coefficients for the offset in between interpolated
+ * from the two nearest. The position moves in 32.32 fixed point,
+ * so any ratio works, not just the ones with small integer terms.
+ * The cutoff sits below the lower of the two Nyquist frequencies.
+ */
+class Resampler {
+public:
+	static constexpr unsigned int TAPS	 = 64; // multiple of 8
+	static constexpr unsigned int PHASES = 256;
+
+private:
+	bool m_active = false;
+	unsigned int m_channels = 1;
+
+	// PHASES + 1 rows, the last one being the first shifted by a tap
+	std::vector<float> m_table;
+
+	// Planar input, starting with the oldest sample still needed
+	std::vector<std::vector<float>> m_input;
+
+	uint_least64_t m_pos = 0;  // from the start of the input, 32.32
+	uint_least64_t m_step = 0; // input frames per output frame
+
+	alignas(16) float m_coefs[TAPS];
+
+	std::vector<float> m_output; // for integer destinations
+
+private:
+	void setCoefficients(uint_least32_t fraction);
+
+	static float dot(const float *samples, const float *coefs);
+
+public:
+	/**
+	 * Set up for a rate change, none if the rates are the same.
+	 */
+	void initialize(uint_least32_t inRate, uint_least32_t outRate, unsigned int channels);
+
+	bool active() const { return m_active; }
+
+	// Forget the input, as after a seek
+	void reset();
+
+	// Input frames it takes to give that many output frames
+	uint_least32_t needed(uint_least32_t frames) const;
+
+	// Interleaved input, as needed() asked for
+	void push(const float *buffer, uint_least32_t frames);
+
+	// Interleaved output: floats from -1 to 1, or integers with
+	// the given number of bits in 32-bit words
+	void pull(float *buffer, uint_least32_t frames);
+	void pull(short *buffer, uint_least32_t frames);
+	void pull(int_least32_t *buffer, uint_least32_t frames, unsigned int bits);
+};
+
+#endif // RESAMPLER_H
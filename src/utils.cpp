@@ -51,3 +51,7 @@ SID_STRING utils::getDataPath() {
 SID_STRING utils::getConfigPath() {
 	return getPath("XDG_CONFIG_HOME", "/.config");
 }
+
+SID_STRING utils::getCachePath() {
+	return getPath("XDG_CACHE_HOME", "/.cache");
+}
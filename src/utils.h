@@ -36,6 +36,7 @@ private:
 public:
 	static SID_STRING getDataPath();
 	static SID_STRING getConfigPath();
+	static SID_STRING getCachePath();
 };
 
 #endif
@@ -0,0 +1,79 @@
+#!/bin/sh
+#
+# Render the tunes written by mkpsid with --fingerprint, and
+# compare the hash of every subtune with the ones recorded in
+# fingerprints.txt. Also fails when rendering is slower than
+# the realtime factor given there, or in MIN_REALTIME.
+#
+# With UPDATE_FINGERPRINTS set, the hashes are recorded instead.
+# They depend on the libsidplayfp version and the emulation, so
+# they have to be updated along with either.
+#
+# Exit codes as automake expects them: 0 passed, 1 failed,
+# 99 hard error. Having nothing recorded is a failure, or the
+# check would pass without comparing anything.
+
+srcdir=${srcdir:-.}
+golden="$srcdir/tests/fingerprints.txt"
+
+c64play=./src/c64play
+mkpsid=./tests/mkpsid
+
+min_realtime=${MIN_REALTIME:-$(sed -n 's/^# min_realtime: *//p' "$golden")}
+min_realtime=${min_realtime:-1}
+
+work=$(mktemp -d) || exit 99
+trap 'rm -rf "$work"' EXIT
+
+# Defaults only, whatever the user has configured
+HOME="$work"
+XDG_CONFIG_HOME="$work/config"
+XDG_CACHE_HOME="$work/cache"
+export HOME XDG_CONFIG_HOME XDG_CACHE_HOME
+
+"$mkpsid" "$work" || exit 99
+
+for tune in "$work"/*.sid; do
+	if ! "$c64play" --fingerprint -l10 "$tune" >> "$work/results"; then
+		echo "FAIL: $(basename "$tune") didn't render"
+		exit 1
+	fi
+done
+
+# md5, subtune, hash and realtime factor from every JSON line
+sed -n 's/.*"md5":"\([0-9a-f]*\)","subtune":\([0-9]*\),.*"realtime_factor":\([0-9.]*\),.*"pcm_hash":"\([0-9a-f]*\)".*/\1 \2 \4 \3/p' \
+	"$work/results" > "$work/parsed"
+
+if [ ! -s "$work/parsed" ]; then
+	echo "FAIL: no fingerprints in the output"
+	exit 1
+fi
+
+cut -d' ' -f1-3 "$work/parsed" | sort > "$work/got"
+
+if [ -n "$UPDATE_FINGERPRINTS" ]; then
+	{ grep '^#' "$golden"; cat "$work/got"; } > "$work/golden"
+	cp "$work/golden" "$golden" || exit 99
+	echo "Recorded $(wc -l < "$work/got") fingerprints in $golden"
+	exit 0
+fi
+
+status=0
+
+if ! awk -v min="$min_realtime" '
+		$4 < min { printf "FAIL: %s subtune %s renders at %sx realtime, under %sx\n", $1, $2, $4, min; slow = 1 }
+		END { exit slow }' "$work/parsed"; then
+	status=1
+fi
+
+grep -v '^#' "$golden" | sort > "$work/want"
+
+if [ ! -s "$work/want" ]; then
+	echo "FAIL: no fingerprints in $golden, record them with make update-fingerprints"
+	status=1
+elif ! diff -u "$work/want" "$work/got"; then
+	echo "FAIL: renders differ from the recorded fingerprints"
+	status=1
+fi
+
+exit $status
@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# Render the tunes written by mkpsid to FLAC and have the
+# reference decoder test the files, which checks every frame's
+# CRC and the MD5 of the audio in STREAMINFO.
+#
+# Exit codes as automake expects them: 0 passed, 1 failed,
+# 77 skipped (no flac to test with), 99 hard error.
+
+c64play=./src/c64play
+mkpsid=./tests/mkpsid
+
+if ! command -v flac > /dev/null 2>&1; then
+	echo "SKIP: flac isn't installed"
+	exit 77
+fi
+
+work=$(mktemp -d) || exit 99
+trap 'rm -rf "$work"' EXIT
+
+# Defaults only, whatever the user has configured
+HOME="$work"
+XDG_CONFIG_HOME="$work/config"
+XDG_CACHE_HOME="$work/cache"
+export HOME XDG_CONFIG_HOME XDG_CACHE_HOME
+
+"$mkpsid" "$work" || exit 99
+
+# Mono, and stereo for the channel decorrelation
+for tune in voices stereo; do
+	if ! "$c64play" -q --flac="$work/$tune.flac" -l5 "$work/$tune.sid" > /dev/null; then
+		echo "FAIL: $tune.sid didn't render"
+		exit 1
+	fi
+
+	if ! flac -s -t "$work/$tune.flac"; then
+		echo "FAIL: $tune.flac doesn't decode"
+		exit 1
+	fi
+done
+
+exit 0
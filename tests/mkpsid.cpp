@@ -0,0 +1,223 @@
+/*
+ * This file is part of C64play, a console player for SID tunes.
+ *
+ * Copyright 2025 Enki Costa
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Writes a few small PSID files for the regression tests, so
+ * that they don't depend on tunes we can't ship. Each one
+ * sets up a voice per subtune in init and sweeps its pitch
+ * and pulse width from play, which is enough to go through
+ * the CPU, the SID and the mixer.
+ *
+ * Usage: mkpsid <directory>
+ */
+
+#include <stdint.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint_least16_t LOAD = 0x1000;
+
+// Variables after the code
+constexpr uint_least16_t SUBTUNE = 0x1080;
+constexpr uint_least16_t COUNTER = 0x1081;
+constexpr uint_least16_t WAVES	 = 0x1090;
+
+// Just the 6502 instructions the tunes need
+class Assembler {
+private:
+	std::vector<uint8_t> m_code;
+
+	void op(uint8_t opcode, uint_least16_t addr) {
+		m_code.push_back(opcode);
+		m_code.push_back(addr & 0xff);
+		m_code.push_back(addr >> 8);
+	}
+
+public:
+	uint_least16_t here() const { return LOAD + m_code.size(); }
+
+	void ldaImm(uint8_t value)			 { m_code.push_back(0xa9); m_code.push_back(value); }
+	void ldxImm(uint8_t value)			 { m_code.push_back(0xa2); m_code.push_back(value); }
+	void lda(uint_least16_t addr)		 { op(0xad, addr); }
+	void ldaX(uint_least16_t addr)		 { op(0xbd, addr); }
+	void ldx(uint_least16_t addr)		 { op(0xae, addr); }
+	void sta(uint_least16_t addr)		 { op(0x8d, addr); }
+	void staX(uint_least16_t addr)		 { op(0x9d, addr); }
+	void inc(uint_least16_t addr)		 { op(0xee, addr); }
+	void dex()							 { m_code.push_back(0xca); }
+	void rts()							 { m_code.push_back(0x60); }
+
+	void bpl(uint_least16_t target) {
+		m_code.push_back(0x10);
+		m_code.push_back(static_cast<uint8_t>(target - (here() + 1)));
+	}
+
+	// Pads up to addr, which has to be past the code
+	bool org(uint_least16_t addr) {
+		if (addr < here())
+			return false;
+
+		m_code.resize(addr - LOAD, 0);
+		return true;
+	}
+
+	void byte(uint8_t value) { m_code.push_back(value); }
+
+	const std::vector<uint8_t> &code() const { return m_code; }
+};
+
+struct tune_t {
+	const char	  *file;
+	const char	  *name;
+	unsigned int   songs;
+	uint8_t		   secondSid; // middle byte of its address, 0 if none
+	uint_least16_t flags;
+};
+
+// Same code for every tune. A second SID takes the next
+// waveform in the table, and sweeps its low frequency byte.
+std::vector<uint8_t> assemble(uint_least16_t &init, uint_least16_t &play, bool stereo) {
+	const uint_least16_t sids[2] = { 0xd400, 0xd420 };
+	const unsigned int count = stereo ? 2 : 1;
+
+	Assembler a;
+
+	init = a.here();
+	a.sta(SUBTUNE);
+
+	for (unsigned int s = 0; s < count; s++) {
+		const uint_least16_t sid = sids[s];
+
+		a.ldaImm(0);
+		a.ldxImm(0x18);
+		const uint_least16_t clear = a.here();
+		a.staX(sid);
+		a.dex();
+		a.bpl(clear);
+
+		a.ldaImm(0x0f);
+		a.sta(sid + 0x18); // volume
+		a.ldaImm(0x09);
+		a.sta(sid + 0x05); // attack/decay
+		a.ldaImm(0xf0);
+		a.sta(sid + 0x06); // sustain/release
+		a.ldaImm(0x08);
+		a.sta(sid + 0x03); // pulse width high
+
+		a.ldx(SUBTUNE);
+		a.ldaX(WAVES + s);
+		a.sta(sid + 0x04);
+	}
+	a.rts();
+
+	play = a.here();
+	a.inc(COUNTER);
+	a.lda(COUNTER);
+	for (unsigned int s = 0; s < count; s++) {
+		a.sta(sids[s] + (s ? 0x00 : 0x01)); // frequency
+		a.sta(sids[s] + 0x02);				// pulse width low
+	}
+	a.rts();
+
+	if (!a.org(SUBTUNE))
+		return std::vector<uint8_t>();
+	a.byte(0);
+	a.byte(0);
+
+	// Pulse, triangle, sawtooth and noise, all gated
+	a.org(WAVES);
+	for (uint8_t wave : { 0x41, 0x11, 0x21, 0x81, 0x41 })
+		a.byte(wave);
+
+	std::vector<uint8_t> data = { LOAD & 0xff, LOAD >> 8 };
+	data.insert(data.end(), a.code().begin(), a.code().end());
+	return data;
+}
+
+void put16(std::vector<uint8_t> &out, size_t pos, uint_least16_t value) {
+	out[pos]	 = value >> 8;
+	out[pos + 1] = value & 0xff;
+}
+
+bool write(const std::string &dir, const tune_t &tune) {
+	uint_least16_t init, play;
+	const std::vector<uint8_t> data = assemble(init, play, tune.secondSid != 0);
+	if (data.empty()) {
+		std::cerr << "mkpsid: code for " << tune.file << " doesn't fit" << std::endl;
+		return false;
+	}
+
+	std::vector<uint8_t> header(0x7c, 0);
+	std::memcpy(header.data(), "PSID", 4);
+	put16(header, 0x04, tune.secondSid ? 3 : 2);
+	put16(header, 0x06, header.size());
+	put16(header, 0x08, 0); // load address from the data
+	put16(header, 0x0a, init);
+	put16(header, 0x0c, play);
+	put16(header, 0x0e, tune.songs);
+	put16(header, 0x10, 1);
+	std::strncpy((char*)&header[0x16], tune.name, 31);
+	std::strncpy((char*)&header[0x36], "C64play", 31);
+	std::strncpy((char*)&header[0x56], "2025 C64play tests", 31);
+	put16(header, 0x76, tune.flags);
+	header[0x7a] = tune.secondSid;
+
+	const std::string path = dir + "/" + tune.file;
+	std::ofstream out(path.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+	out.write((const char*)header.data(), header.size());
+	out.write((const char*)data.data(), data.size());
+	out.close();
+
+	if (out.fail()) {
+		std::cerr << "mkpsid: can't write " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	if (argc != 2) {
+		std::cerr << "Usage: mkpsid <directory>" << std::endl;
+		return 2;
+	}
+
+	// Flags: PAL, with 6581s or 8580s
+	const tune_t tunes[] = {
+		{ "voices.sid", "Voices",  4, 0x00, 0x0014 },
+		{ "8580.sid",	"8580",	   2, 0x00, 0x0024 },
+		{ "stereo.sid", "Stereo",  2, 0x42, 0x0014 },
+	};
+
+	for (const tune_t &tune : tunes) {
+		if (!write(argv[1], tune))
+			return 1;
+	}
+
+	return 0;
+}